@@ -0,0 +1,51 @@
+#version 150
+
+// Fast approximate antialiasing (after Lottes' FXAA) of the frame drawn into
+// u_Frame. The luma gradient over the four diagonal neighbours gives the
+// direction of the edge through a pixel, and the pixel is blurred along it,
+// more widely where the edge is nearly horizontal or vertical. Pixels off
+// any edge sample the same colour four times and are left as they are.
+
+uniform sampler2D u_Frame;
+
+out vec4 out_Col;
+
+const float SPAN_MAX = 8.0;          // the furthest the blur reaches, in pixels
+const float REDUCE_MUL = 1.0 / 8.0;  // keeps the blur short on low contrast edges
+const float REDUCE_MIN = 1.0 / 128.0;
+
+const vec3 LUMA = vec3(0.299, 0.587, 0.114);
+
+vec3 frame(vec2 uv)
+{
+    return texture(u_Frame, uv).rgb;
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(u_Frame, 0));
+    vec2 uv = gl_FragCoord.xy * texel;
+
+    float lumaNW = dot(frame(uv + vec2(-1.0, -1.0) * texel), LUMA);
+    float lumaNE = dot(frame(uv + vec2(1.0, -1.0) * texel), LUMA);
+    float lumaSW = dot(frame(uv + vec2(-1.0, 1.0) * texel), LUMA);
+    float lumaSE = dot(frame(uv + vec2(1.0, 1.0) * texel), LUMA);
+    float lumaM = dot(frame(uv), LUMA);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Perpendicular to the luma gradient, so along the edge
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+                    (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(dir.x), abs(dir.y)) + reduce);
+    dir = clamp(dir * scale, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    // Two taps close to the pixel, and two more further out. The wider blur
+    // is only kept if it didn't reach past the contrast around the pixel,
+    // i.e. into a different surface.
+    vec3 inner = 0.5 * (frame(uv + dir * (1.0 / 3.0 - 0.5)) + frame(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 outer = 0.5 * inner + 0.25 * (frame(uv - dir * 0.5) + frame(uv + dir * 0.5));
+    float lumaOuter = dot(outer, LUMA);
+    out_Col = vec4(lumaOuter < lumaMin || lumaOuter > lumaMax ? inner : outer, 1.0);
+}
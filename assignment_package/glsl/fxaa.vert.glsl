@@ -0,0 +1,11 @@
+#version 150
+
+// The fullscreen triangle of the FXAA pass (see AntiAliasing), made from
+// gl_VertexID alone: (-1, -1), (3, -1) and (-1, 3) cover the whole screen
+// with no vertex buffer at all.
+
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
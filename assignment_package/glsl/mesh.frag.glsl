@@ -0,0 +1,72 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// This is a fragment shader. If you've opened this file first, please
+// open and read mesh.vert.glsl before reading on, which also lists the
+// features a variant can be compiled with.
+// Unlike the vertex shader, the fragment shader actually does compute
+// the shading of geometry. For every pixel in your program's output
+// screen, the fragment shader is run for every bit of geometry that
+// particular pixel overlaps. By implicitly interpolating the position
+// data passed into the fragment shader by the vertex shader, the fragment shader
+// can compute what color to apply to its pixel based on things like vertex
+// position, light position, and vertex color.
+
+// These are the interpolated values out of the rasterizer, so you can't know
+// their specific values without knowing the vertices that contributed to them
+#ifndef FACE_COLOURS
+in vec4 fs_Col;
+#endif
+
+#ifdef LAMBERT
+in vec3 fs_Pos;
+in vec4 fs_Nor;
+
+layout(std140) uniform FrameConstants {
+    mat4 u_ViewProj;
+    vec4 u_CamPos;
+};
+#endif
+
+#ifdef FACE_COLOURS
+// Meshes drawn with shared vertices have no per-vertex colour, so triangle i
+// of the draw is coloured by texel u_TriangleBase + i of u_FaceCol instead.
+// u_TriangleBase is where the draw starts in the index buffer, which is 0
+// unless only some ranges of the mesh are drawn. Mesh overlays colour their
+// points and lines the same way.
+uniform samplerBuffer u_FaceCol;
+uniform int u_TriangleBase;
+#endif
+
+out vec4 out_Col; // This is the final output color that you will see on your
+                  // screen for the pixel that is currently being processed.
+
+void main()
+{
+    // Material base color (before shading)
+#ifdef FACE_COLOURS
+    vec4 diffuseColor = texelFetch(u_FaceCol, u_TriangleBase + gl_PrimitiveID);
+#else
+    vec4 diffuseColor = fs_Col;
+#endif
+
+#ifdef LAMBERT
+    // Calculate the diffuse term for Lambert shading
+    vec3 lightVec = normalize(u_CamPos.xyz - fs_Pos);
+    float diffuseTerm = dot(normalize(fs_Nor.xyz), normalize(lightVec));
+    // Avoid negative lighting values
+    diffuseTerm = clamp(diffuseTerm, 0, 1);
+
+    float ambientTerm = 0.2;
+
+    float lightIntensity = diffuseTerm + ambientTerm;   //Add a small float value to the color multiplier
+                                                        //to simulate ambient lighting. This ensures that faces that are not
+                                                        //lit by our point light are not completely black.
+
+    // Compute final shaded color
+    out_Col = vec4(diffuseColor.rgb * lightIntensity, diffuseColor.a);
+#else
+    // Copy the color; there is no shading.
+    out_Col = diffuseColor;
+#endif
+}
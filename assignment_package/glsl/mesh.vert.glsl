@@ -0,0 +1,164 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+//This is a vertex shader. While it is called a "shader" due to outdated conventions, this file
+//is used to apply matrix transformations to the arrays of vertex data passed to it.
+//Since this code is run on your GPU, each vertex is transformed simultaneously.
+//If it were run on your CPU, each vertex would have to be processed in a FOR loop, one at a time.
+//This simultaneous transformation allows your program to run much faster, especially when rendering
+//geometry with millions of vertices.
+
+// Every variant of the mesh shaders is compiled from this file and
+// mesh.frag.glsl, with a #define inserted after the #version line for each
+// feature it has (see ShaderVariants):
+//   SKINNED       blends the joint transforms in u_Palette by vs_Jnt and vs_Inf
+//   DUAL_QUAT     reads u_Palette as dual quaternions instead of matrices (SKINNED only)
+//   LAMBERT       passes the normals on for diffuse shading
+//   FACE_COLOURS  takes the colour from u_FaceCol in the fragment shader, so vs_Col is unused
+//   INSTANCED     moves and tints every instance of an instanced draw by its texels in u_Instances
+// A variant without a feature doesn't declare its inputs or uniforms at all.
+
+uniform mat4 u_Model;       // The matrix that defines the transformation of the
+                            // object we're rendering. In this assignment,
+                            // this will be the result of traversing your scene graph.
+
+#ifdef LAMBERT
+uniform mat4 u_ModelInvTr;  // The inverse transpose of the model matrix.
+                            // This allows us to transform the object's normals properly
+                            // if the object has been non-uniformly scaled.
+#endif
+
+layout(std140) uniform FrameConstants {
+    mat4 u_ViewProj;        // The matrix that defines the camera's transformation.
+    vec4 u_CamPos;          // The camera position, w unused. Shared by every program
+};                          // and uploaded once per frame (see FrameConstants).
+
+in vec4 vs_Pos;             // The array of vertex positions passed to the shader
+
+#ifndef FACE_COLOURS
+in vec4 vs_Col;             // The array of vertex colors passed to the shader.
+#endif
+
+#ifdef LAMBERT
+in vec4 vs_Nor;             // The array of vertex normals passed to the shader
+out vec4 fs_Nor;            // The array of normals that has been transformed by u_ModelInvTr. This is implicitly passed to the fragment shader.
+#endif
+
+#ifdef INSTANCED
+uniform samplerBuffer u_Instances; // Five texels per instance: the columns of its model matrix, applied
+                                   // before u_Model, then a colour it's tinted towards by the colour's alpha
+uniform int u_InstanceBase;        // The texel the first instance starts at, past the regions of other
+                                   // frames when the instances are streamed (see StreamBuffer)
+#endif
+
+#ifdef SKINNED
+uniform samplerBuffer u_Palette; // The skinning transform of every joint (see SkinPalette): the
+                                 // matrix of joint i in texels 4i to 4i + 3, or with DUAL_QUAT,
+                                 // its dual quaternion's real part in texel 2i and dual part in 2i + 1
+in ivec2 vs_Jnt;            // The two joints each vertex is bound to
+in vec2 vs_Inf;             // and their influences, which sum to 1 for bound vertices and 0 otherwise
+#endif
+
+#ifdef LAMBERT
+out vec3 fs_Pos;
+#endif
+#ifndef FACE_COLOURS
+out vec4 fs_Col;            // The color of each vertex. This is implicitly passed to the fragment shader.
+#endif
+
+#ifdef SKINNED
+#ifdef DUAL_QUAT
+// Rotates v by the unit quaternion r
+vec3 quatRotate(vec4 r, vec3 v)
+{
+    return v + 2.0 * cross(r.xyz, cross(r.xyz, v) + r.w * v);
+}
+
+// Dual quaternion linear blending: the joint transforms are weighted by their
+// influences and renormalized, which keeps the result rigid. Whatever weight
+// the influences leave goes to the identity, so unbound vertices stay put.
+void skin(inout vec4 pos, inout vec3 nor)
+{
+    vec4 r0 = texelFetch(u_Palette, 2 * vs_Jnt[0]);
+    vec4 d0 = texelFetch(u_Palette, 2 * vs_Jnt[0] + 1);
+    vec4 r1 = texelFetch(u_Palette, 2 * vs_Jnt[1]);
+    vec4 d1 = texelFetch(u_Palette, 2 * vs_Jnt[1] + 1);
+    // q and -q are the same transform, so the second joint is flipped
+    // into the first one's hemisphere to blend along the shorter path
+    float w1 = dot(r0, r1) < 0.0 ? -vs_Inf[1] : vs_Inf[1];
+    vec4 r = vec4(0.0, 0.0, 0.0, 1.0 - vs_Inf[0] - vs_Inf[1]) + vs_Inf[0] * r0 + w1 * r1;
+    vec4 d = vs_Inf[0] * d0 + w1 * d1;
+    float len = length(r);
+    r /= len;
+    d /= len;
+    pos.xyz = quatRotate(r, pos.xyz) + 2.0 * (r.w * d.xyz - d.w * r.xyz + cross(r.xyz, d.xyz));
+    nor = quatRotate(r, nor);
+}
+#else
+mat4 jointMatrix(int j)
+{
+    return mat4(texelFetch(u_Palette, 4 * j),
+                texelFetch(u_Palette, 4 * j + 1),
+                texelFetch(u_Palette, 4 * j + 2),
+                texelFetch(u_Palette, 4 * j + 3));
+}
+
+// Linear blend skinning: the joint matrices weighted by their influences.
+// Whatever weight the influences leave goes to the identity, so unbound
+// vertices stay put.
+void skin(inout vec4 pos, inout vec3 nor)
+{
+    mat4 blend = (1.0 - vs_Inf[0] - vs_Inf[1]) * mat4(1.0)
+               + vs_Inf[0] * jointMatrix(vs_Jnt[0])
+               + vs_Inf[1] * jointMatrix(vs_Jnt[1]);
+    pos = blend * pos;
+    nor = mat3(blend) * nor;
+}
+#endif
+#endif
+
+void main()
+{
+#ifdef INSTANCED
+    int instance = u_InstanceBase + 5 * gl_InstanceID;
+    mat4 instanceModel = mat4(texelFetch(u_Instances, instance),
+                              texelFetch(u_Instances, instance + 1),
+                              texelFetch(u_Instances, instance + 2),
+                              texelFetch(u_Instances, instance + 3));
+    vec4 tint = texelFetch(u_Instances, instance + 4);
+#else
+    mat4 instanceModel = mat4(1.0);
+#endif
+
+#ifndef FACE_COLOURS
+    fs_Col = vs_Col;                         // Pass the vertex colors to the fragment shader for interpolation
+#ifdef INSTANCED
+    fs_Col = mix(vs_Col, vec4(tint.rgb, 1.0), tint.a);
+#endif
+#endif
+
+    vec4 modelposition = u_Model * instanceModel * vs_Pos; // Temporarily store the transformed vertex positions for use below
+
+#ifdef LAMBERT
+    // Transform the geometry's normals by the inverse transpose of the
+    // model matrix. This is necessary to ensure the normals remain
+    // perpendicular to the surface after the surface is transformed by
+    // the model matrix. The instance matrices are rigid, so they can turn
+    // the normals as they are.
+    vec3 normal = mat3(u_ModelInvTr) * mat3(instanceModel) * vec3(vs_Nor);
+#else
+    vec3 normal = vec3(0.0);
+#endif
+
+#ifdef SKINNED
+    skin(modelposition, normal);
+#endif
+
+#ifdef LAMBERT
+    fs_Nor = vec4(normal, 0);
+    fs_Pos = modelposition.xyz;
+#endif
+
+    gl_Position = u_ViewProj * modelposition;// gl_Position is a built-in variable of OpenGL which is
+                                             // used to render the final positions of the geometry's vertices
+}
@@ -0,0 +1,559 @@
+#include "adaptivesubdivision.h"
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+
+AdaptiveSubdivision::AdaptiveSubdivision(OpenGLContext *context)
+    : Drawable(context), src(nullptr), dirty(true), screen(), changedFaces(), allFaces(),
+      vertEnd(0), idxEnd(0), vertCapacity(0), idxCapacity(0),
+      maxLevel(4), targetEdgePixels(24.f), hysteresis(0.25f)
+{}
+
+void AdaptiveSubdivision::setSource(Mesh *mesh)
+{
+    src = mesh;
+    controlLevels.clear();
+    dirty = true;
+}
+
+void AdaptiveSubdivision::invalidate()
+{
+    dirty = true;
+}
+
+int AdaptiveSubdivision::triangleCount()
+{
+    int tris = 0;
+    for (Patch &p : patches){
+        tris += p.idx.size() / 3;
+    }
+    return tris;
+}
+
+// Projects the face onto the screen and picks the depth that brings its longest
+// edge down to roughly targetEdgePixels. Faces entirely outside the view frustum
+// are left unrefined.
+int AdaptiveSubdivision::faceLevel(Face *f, const glm::mat4 &viewProj, float w, float h, int prevLevel)
+{
+    screen.clear();
+    bool behindCamera = false;
+
+    // Counts how many corners lie outside each of the six clip planes;
+    // if all corners are outside the same plane the face can't be seen
+    int outside[6] = {0, 0, 0, 0, 0, 0};
+    int corners = 0;
+    HalfEdge *curr = f->edge;
+    do {
+        glm::vec4 clip = viewProj * glm::vec4(curr->vert->pos, 1.f);
+        outside[0] += clip.x < -clip.w;
+        outside[1] += clip.x > clip.w;
+        outside[2] += clip.y < -clip.w;
+        outside[3] += clip.y > clip.w;
+        outside[4] += clip.z < -clip.w;
+        outside[5] += clip.z > clip.w;
+        if (clip.w <= 0.f){
+            behindCamera = true;
+        } else {
+            screen.push_back(glm::vec2((clip.x / clip.w + 1.f) * 0.5f * w,
+                                       (1.f - clip.y / clip.w) * 0.5f * h));
+        }
+        corners++;
+        curr = curr->next;
+    } while (curr != f->edge);
+
+    for (int i = 0; i < 6; i++){
+        if (outside[i] == corners){
+            return 0;
+        }
+    }
+
+    // A face crossing the camera plane is as close as a face can be
+    if (behindCamera){
+        return maxLevel;
+    }
+
+    float longest = 0.f;
+    for (size_t i = 0; i < screen.size(); i++){
+        longest = glm::max(longest, glm::length(screen[i] - screen[(i + 1) % screen.size()]));
+    }
+    if (longest <= targetEdgePixels){
+        return 0;
+    }
+
+    // Every level halves the edge length, so the continuous level is log2 of the ratio
+    float exact = glm::log2(longest / targetEdgePixels);
+    int level = glm::clamp(int(glm::ceil(exact)), 0, maxLevel);
+
+    // Stay at the previous level while the face is near the boundary between
+    // the two levels
+    if (prevLevel >= 0 && level != prevLevel
+            && glm::abs(exact - (prevLevel - 0.5f)) < 0.5f + hysteresis){
+        return prevLevel;
+    }
+    return level;
+}
+
+bool AdaptiveSubdivision::update(Camera &cam)
+{
+    if (!src){
+        return false;
+    }
+    glm::mat4 viewProj = cam.getViewProj();
+
+    int faceCount = src->faces.size();
+    bool rebuild = dirty || int(controlLevels.size()) != faceCount;
+    if (rebuild){
+        loadControl();
+        controlLevels.assign(faceCount, -1);
+    }
+
+    // Only the per-face levels are re-evaluated every frame
+    changedFaces.clear();
+    int deepest = 0;
+    for (int i = 0; i < faceCount; i++){
+        int level = faceLevel(src->facePtr(i), viewProj, cam.width, cam.height, controlLevels[i]);
+        deepest = glm::max(deepest, glm::max(level, controlLevels[i]));
+        if (level != controlLevels[i]){
+            controlLevels[i] = level;
+            changedFaces.push_back(i);
+        }
+    }
+
+    if (int(allFaces.size()) != faceCount){
+        allFaces.resize(faceCount);
+        std::iota(allFaces.begin(), allFaces.end(), 0);
+    }
+    if (rebuild){
+        refine(allFaces, allFaces);
+        dirty = false;
+        return true;
+    }
+    if (changedFaces.empty()){
+        return false;
+    }
+
+    // Each pass reads the faces sharing a vertex with the one refined, so
+    // after deepest passes a face depends on the faces up to deepest steps
+    // away. Those are refined again, and they need as many steps around
+    // them to come out the same as in a refinement of the whole mesh.
+    std::vector<int> patched = ring(changedFaces, deepest);
+    std::vector<int> region = ring(patched, deepest + 1);
+    if (int(region.size()) * 2 > faceCount){
+        refine(allFaces, allFaces);
+        return true;
+    }
+    refine(region, patched);
+    return !upload(patched);
+}
+
+void AdaptiveSubdivision::loadControl()
+{
+    controlVerts.clear();
+    controlStart.clear();
+    controlFaceVerts.clear();
+
+    // Vertex iDs aren't guaranteed to match their index in the mesh, so the
+    // indices are looked up by pointer
+    std::unordered_map<Vertex*, int> vertIdx;
+    int vertCount = src->vertices.size();
+    int faceCount = src->faces.size();
+    for (int i = 0; i < vertCount; i++){
+        vertIdx[src->vertPtr(i)] = i;
+        controlVerts.push_back(src->vertPtr(i)->pos);
+    }
+    for (int i = 0; i < faceCount; i++){
+        Face *f = src->facePtr(i);
+        controlStart.push_back(controlFaceVerts.size());
+        HalfEdge *curr = f->edge;
+        do {
+            controlFaceVerts.push_back(vertIdx[curr->vert]);
+            curr = curr->next;
+        } while (curr != f->edge);
+    }
+    controlStart.push_back(controlFaceVerts.size());
+
+    vertFaceStart.assign(vertCount + 1, 0);
+    for (int v : controlFaceVerts){
+        vertFaceStart[v + 1]++;
+    }
+    for (int v = 0; v < vertCount; v++){
+        vertFaceStart[v + 1] += vertFaceStart[v];
+    }
+    vertFaces.resize(controlFaceVerts.size());
+    std::vector<int> next(vertFaceStart.begin(), vertFaceStart.end() - 1);
+    for (int f = 0; f < faceCount; f++){
+        for (int i = controlStart[f]; i < controlStart[f + 1]; i++){
+            vertFaces[next[controlFaceVerts[i]]++] = f;
+        }
+    }
+    patches.assign(faceCount, Patch());
+}
+
+void AdaptiveSubdivision::loadControlMesh(const std::vector<int> &faces)
+{
+    verts.clear();
+    faceStart.clear();
+    faceVerts.clear();
+    faceSrc.clear();
+
+    std::vector<int> local(controlVerts.size(), -1);
+    for (int f : faces){
+        faceStart.push_back(faceVerts.size());
+        for (int i = controlStart[f]; i < controlStart[f + 1]; i++){
+            int v = controlFaceVerts[i];
+            if (local[v] == -1){
+                local[v] = verts.size();
+                verts.push_back(controlVerts[v]);
+            }
+            faceVerts.push_back(local[v]);
+        }
+        faceSrc.push_back(f);
+    }
+    faceStart.push_back(faceVerts.size());
+}
+
+std::vector<int> AdaptiveSubdivision::ring(const std::vector<int> &faces, int depth)
+{
+    std::vector<bool> reached(controlLevels.size(), false);
+    std::vector<int> result;
+    for (int f : faces){
+        if (!reached[f]){
+            reached[f] = true;
+            result.push_back(f);
+        }
+    }
+    size_t first = 0;
+    for (int step = 0; step < depth; step++){
+        size_t last = result.size();
+        for (size_t i = first; i < last; i++){
+            int f = result[i];
+            for (int c = controlStart[f]; c < controlStart[f + 1]; c++){
+                int v = controlFaceVerts[c];
+                for (int j = vertFaceStart[v]; j < vertFaceStart[v + 1]; j++){
+                    if (!reached[vertFaces[j]]){
+                        reached[vertFaces[j]] = true;
+                        result.push_back(vertFaces[j]);
+                    }
+                }
+            }
+        }
+        first = last;
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+void AdaptiveSubdivision::refine(const std::vector<int> &region, const std::vector<int> &patched)
+{
+    loadControlMesh(region);
+    int deepest = 0;
+    for (int f : region){
+        deepest = glm::max(deepest, controlLevels[f]);
+    }
+    for (int level = 1; level <= deepest; level++){
+        refinePass(level);
+    }
+
+    std::vector<bool> rebuilt(controlLevels.size(), false);
+    for (int f : patched){
+        rebuilt[f] = true;
+        Patch &p = patches[f];
+        p.pos.clear();
+        p.nor.clear();
+        p.col.clear();
+        p.idx.clear();
+    }
+
+    int faceCount = faceSrc.size();
+    for (int f = 0; f < faceCount; f++){
+        if (!rebuilt[faceSrc[f]]){
+            continue;
+        }
+        Patch &p = patches[faceSrc[f]];
+        int first = faceStart[f];
+        int n = faceStart[f + 1] - first;
+
+        // Newell's method gives a stable normal even when edge points make
+        // some of the corners collinear. It's negated to match the winding
+        // used by Mesh::create.
+        glm::vec3 normal(0.f);
+        for (int i = 0; i < n; i++){
+            const glm::vec3 &a = verts[faceVerts[first + i]];
+            const glm::vec3 &b = verts[faceVerts[first + (i + 1) % n]];
+            normal += glm::cross(a, b);
+        }
+        if (glm::length(normal) > 0.f){
+            normal = -glm::normalize(normal);
+        }
+
+        glm::vec4 colour(src->facePtr(faceSrc[f])->colour, 1.f);
+        GLuint vertIdx = p.pos.size();
+        for (int i = 0; i < n; i++){
+            p.pos.push_back(glm::vec4(verts[faceVerts[first + i]], 1.f));
+            p.nor.push_back(glm::vec4(normal, 0.f));
+            p.col.push_back(colour);
+        }
+        for (int i = 1; i < n - 1; i++){
+            p.idx.push_back(vertIdx);
+            p.idx.push_back(vertIdx + i);
+            p.idx.push_back(vertIdx + i + 1);
+        }
+    }
+}
+
+bool AdaptiveSubdivision::upload(const std::vector<int> &changed)
+{
+    if (!idxBound){
+        return false;
+    }
+    for (int f : changed){
+        Patch &p = patches[f];
+        int vertCount = p.pos.size();
+        int idxCount = p.idx.size();
+        if (vertCount > p.vertRoom || idxCount > p.idxRoom){
+            if (vertEnd + vertCount > vertCapacity || idxEnd + idxCount > idxCapacity){
+                return false;
+            }
+            // The old slot is left as degenerate triangles until the next create()
+            std::vector<GLuint> degenerate(p.idxRoom, 0);
+            mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+            mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, p.idxFirst * sizeof(GLuint),
+                                        degenerate.size() * sizeof(GLuint), degenerate.data());
+            p.vertFirst = vertEnd;
+            p.vertRoom = vertCount;
+            p.idxFirst = idxEnd;
+            p.idxRoom = idxCount;
+            vertEnd += vertCount;
+            idxEnd += idxCount;
+            count = idxEnd;
+        }
+
+        // The rest of a slot the patch shrank in is filled with degenerate
+        // triangles on its first vertex
+        std::vector<GLuint> idx(p.idxRoom, p.vertFirst);
+        for (int i = 0; i < idxCount; i++){
+            idx[i] = p.idx[i] + p.vertFirst;
+        }
+        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+        mp_context->glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, p.idxFirst * sizeof(GLuint),
+                                    idx.size() * sizeof(GLuint), idx.data());
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+        mp_context->glBufferSubData(GL_ARRAY_BUFFER, p.vertFirst * sizeof(glm::vec4), vertCount * sizeof(glm::vec4), p.pos.data());
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
+        mp_context->glBufferSubData(GL_ARRAY_BUFFER, p.vertFirst * sizeof(glm::vec4), vertCount * sizeof(glm::vec4), p.nor.data());
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+        mp_context->glBufferSubData(GL_ARRAY_BUFFER, p.vertFirst * sizeof(glm::vec4), vertCount * sizeof(glm::vec4), p.col.data());
+    }
+    return true;
+}
+
+// Key for the undirected edge between vertices a and b
+static inline unsigned long long edgeKey(int a, int b)
+{
+    if (a > b){
+        std::swap(a, b);
+    }
+    return (unsigned long long)(a) << 32 | (unsigned int)(b);
+}
+
+void AdaptiveSubdivision::refinePass(int level)
+{
+    struct EdgeInfo {
+        int faceA = -1;
+        int faceB = -1;
+        int midpoint = -1;
+    };
+
+    int faceCount = faceSrc.size();
+    int vertCutoff = verts.size();
+
+    std::vector<bool> refined(faceCount);
+    std::vector<glm::vec3> centroids(faceCount);
+    for (int f = 0; f < faceCount; f++){
+        refined[f] = controlLevels[faceSrc[f]] >= level;
+        glm::vec3 centroid(0.f);
+        for (int i = faceStart[f]; i < faceStart[f + 1]; i++){
+            centroid += verts[faceVerts[i]];
+        }
+        centroids[f] = centroid / float(faceStart[f + 1] - faceStart[f]);
+    }
+
+    // Face adjacency of every edge
+    std::unordered_map<unsigned long long, EdgeInfo> edges;
+    edges.reserve(faceVerts.size());
+    for (int f = 0; f < faceCount; f++){
+        int n = faceStart[f + 1] - faceStart[f];
+        for (int i = 0; i < n; i++){
+            int a = faceVerts[faceStart[f] + i];
+            int b = faceVerts[faceStart[f] + (i + 1) % n];
+            EdgeInfo &e = edges[edgeKey(a, b)];
+            if (e.faceA == -1){
+                e.faceA = f;
+            } else {
+                e.faceB = f;
+            }
+        }
+    }
+
+    // Edge points for every edge touching a refined face. Boundary edges
+    // use the plain midpoint.
+    for (std::pair<const unsigned long long, EdgeInfo> &entry : edges){
+        EdgeInfo &e = entry.second;
+        if (!refined[e.faceA] && (e.faceB == -1 || !refined[e.faceB])){
+            continue;
+        }
+        int a = int(entry.first >> 32);
+        int b = int(entry.first & 0xffffffff);
+        glm::vec3 midpoint;
+        if (e.faceB == -1){
+            midpoint = (verts[a] + verts[b]) * 0.5f;
+        } else {
+            midpoint = (verts[a] + verts[b] + centroids[e.faceA] + centroids[e.faceB]) / 4.f;
+        }
+        e.midpoint = verts.size();
+        verts.push_back(midpoint);
+    }
+
+    // Smooths the original vertices whose surrounding faces are all refined, using
+    // the same rule as MyGL::catmullClark. Vertices on the border of the refined
+    // region, or on a mesh boundary, keep their position so the coarser
+    // neighbours don't change shape.
+    std::vector<glm::vec3> sumAdjacent(vertCutoff, glm::vec3(0.f));
+    std::vector<glm::vec3> sumCentroids(vertCutoff, glm::vec3(0.f));
+    std::vector<int> valence(vertCutoff, 0);
+    std::vector<bool> movable(vertCutoff, true);
+    for (int f = 0; f < faceCount; f++){
+        for (int i = faceStart[f]; i < faceStart[f + 1]; i++){
+            int v = faceVerts[i];
+            sumCentroids[v] += centroids[f];
+            valence[v]++;
+            if (!refined[f]){
+                movable[v] = false;
+            }
+        }
+    }
+    for (std::pair<const unsigned long long, EdgeInfo> &entry : edges){
+        int a = int(entry.first >> 32);
+        int b = int(entry.first & 0xffffffff);
+        sumAdjacent[a] += verts[b];
+        sumAdjacent[b] += verts[a];
+        if (entry.second.faceB == -1){
+            movable[a] = false;
+            movable[b] = false;
+        }
+    }
+    for (int v = 0; v < vertCutoff; v++){
+        if (movable[v] && valence[v] > 0){
+            float n = valence[v];
+            verts[v] = ((n - 2) * verts[v]) / n + sumAdjacent[v] / (n * n) + sumCentroids[v] / (n * n);
+        }
+    }
+
+    // Rebuilds the face list. Unrefined faces keep their corners plus any edge
+    // points inserted on their edges; refined faces are split into one polygon
+    // per edge point pair, all sharing the face's centroid.
+    std::vector<int> newStart;
+    std::vector<int> newVerts;
+    std::vector<int> newSrc;
+    newStart.reserve(faceCount * 4 + 1);
+    newVerts.reserve(faceVerts.size() * 4);
+    newSrc.reserve(faceCount * 4);
+
+    std::vector<int> boundary;
+    std::vector<bool> isEdgePoint;
+    for (int f = 0; f < faceCount; f++){
+        int n = faceStart[f + 1] - faceStart[f];
+        boundary.clear();
+        isEdgePoint.clear();
+        for (int i = 0; i < n; i++){
+            int a = faceVerts[faceStart[f] + i];
+            int b = faceVerts[faceStart[f] + (i + 1) % n];
+            boundary.push_back(a);
+            isEdgePoint.push_back(false);
+            int midpoint = edges[edgeKey(a, b)].midpoint;
+            if (midpoint != -1){
+                boundary.push_back(midpoint);
+                isEdgePoint.push_back(true);
+            }
+        }
+
+        if (!refined[f]){
+            newStart.push_back(newVerts.size());
+            newVerts.insert(newVerts.end(), boundary.begin(), boundary.end());
+            newSrc.push_back(faceSrc[f]);
+            continue;
+        }
+
+        int centroid = verts.size();
+        verts.push_back(centroids[f]);
+        int m = boundary.size();
+        for (int i = 0; i < m; i++){
+            if (!isEdgePoint[i]){
+                continue;
+            }
+            // One child runs from this edge point to the next one along the face
+            newStart.push_back(newVerts.size());
+            newVerts.push_back(centroid);
+            int j = i;
+            do {
+                newVerts.push_back(boundary[j]);
+                j = (j + 1) % m;
+            } while (!isEdgePoint[j]);
+            newVerts.push_back(boundary[j]);
+            newSrc.push_back(faceSrc[f]);
+        }
+    }
+    newStart.push_back(newVerts.size());
+
+    faceStart.swap(newStart);
+    faceVerts.swap(newVerts);
+    faceSrc.swap(newSrc);
+}
+
+void AdaptiveSubdivision::create()
+{
+    // Every patch gets a slot of its own size, and the buffers get half as
+    // much again free at the end for patches that outgrow theirs
+    vertEnd = idxEnd = 0;
+    for (Patch &p : patches){
+        p.vertFirst = vertEnd;
+        p.vertRoom = p.pos.size();
+        p.idxFirst = idxEnd;
+        p.idxRoom = p.idx.size();
+        vertEnd += p.vertRoom;
+        idxEnd += p.idxRoom;
+    }
+    vertCapacity = vertEnd + vertEnd / 2;
+    idxCapacity = idxEnd + idxEnd / 2;
+
+    std::vector<glm::vec4> pos(vertCapacity);
+    std::vector<glm::vec4> nor(vertCapacity);
+    std::vector<glm::vec4> col(vertCapacity);
+    std::vector<GLuint> idx(idxCapacity, 0);
+    for (Patch &p : patches){
+        std::copy(p.pos.begin(), p.pos.end(), pos.begin() + p.vertFirst);
+        std::copy(p.nor.begin(), p.nor.end(), nor.begin() + p.vertFirst);
+        std::copy(p.col.begin(), p.col.end(), col.begin() + p.vertFirst);
+        for (int i = 0; i < p.idxRoom; i++){
+            idx[p.idxFirst + i] = p.idx[i] + p.vertFirst;
+        }
+    }
+
+    count = idxEnd;
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_DYNAMIC_DRAW);
+
+    generatePos();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, pos.size() * sizeof(glm::vec4), pos.data(), GL_DYNAMIC_DRAW);
+
+    generateNor();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, nor.size() * sizeof(glm::vec4), nor.data(), GL_DYNAMIC_DRAW);
+
+    generateCol();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, col.size() * sizeof(glm::vec4), col.data(), GL_DYNAMIC_DRAW);
+}
@@ -0,0 +1,131 @@
+#ifndef ADAPTIVESUBDIVISION_H
+#define ADAPTIVESUBDIVISION_H
+
+#include <drawable.h>
+#include <mesh.h>
+#include <camera.h>
+#include <vector>
+
+// A render-only refinement of a control Mesh. Every control face gets its own
+// Catmull-Clark depth based on how large it appears on screen, so the triangle
+// count follows screen coverage instead of one global subdivision level.
+// The control mesh itself is never modified.
+class AdaptiveSubdivision : public Drawable
+{
+private:
+    // The mesh whose faces are refined
+    Mesh *src;
+
+    // The subdivision depth picked for every control face during the last update()
+    std::vector<int> controlLevels;
+
+    // Set when the control mesh changed and the refinement has to be rebuilt
+    // even if no face level changed
+    bool dirty;
+
+    // Kept between update() calls so re-evaluating the levels every frame
+    // allocates nothing: the on-screen corners of the face faceLevel() is
+    // looking at, the faces whose level changed, and every face in order
+    std::vector<glm::vec2> screen;
+    std::vector<int> changedFaces;
+    std::vector<int> allFaces;
+
+    // The control mesh as polygons over vertex indices, copied by
+    // loadControl(), and the faces around every vertex as ranges of
+    // vertFaces given by vertFaceStart
+    std::vector<glm::vec3> controlVerts;
+    std::vector<int> controlStart;
+    std::vector<int> controlFaceVerts;
+    std::vector<int> vertFaceStart;
+    std::vector<int> vertFaces;
+
+    // The polygons being refined. Faces are stored as ranges of faceVerts
+    // given by faceStart, and faceSrc holds the index of the control face
+    // each one came from (used for its level and its colour).
+    std::vector<glm::vec3> verts;
+    std::vector<int> faceStart;
+    std::vector<int> faceVerts;
+    std::vector<int> faceSrc;
+
+    // The refinement of one control face, as the corners of its triangles
+    // (indexed from 0), and the slots it's uploaded to. A patch that
+    // outgrows its slot is moved to the free space at the end of the
+    // buffers, and its old slot is filled with degenerate triangles.
+    struct Patch {
+        std::vector<glm::vec4> pos;
+        std::vector<glm::vec4> nor;
+        std::vector<glm::vec4> col;
+        std::vector<GLuint> idx;
+        int vertFirst = 0;
+        int vertRoom = 0;
+        int idxFirst = 0;
+        int idxRoom = 0;
+    };
+    std::vector<Patch> patches;
+
+    // The used part of the buffers, and their size
+    int vertEnd;
+    int idxEnd;
+    int vertCapacity;
+    int idxCapacity;
+
+    // Computes the depth of a single control face from its projected size
+    int faceLevel(Face *f, const glm::mat4 &viewProj, float w, float h, int prevLevel);
+
+    // Copies the control mesh's vertices and faces
+    void loadControl();
+
+    // Loads the given control faces into the polygon arrays
+    void loadControlMesh(const std::vector<int> &faces);
+
+    // The given faces and every face within depth vertex-sharing steps of
+    // them, in increasing order
+    std::vector<int> ring(const std::vector<int> &faces, int depth);
+
+    // Performs one Catmull-Clark pass on every face whose control face wants
+    // at least `level` levels. Edges shared with coarser faces are split too,
+    // which keeps the surface crack free.
+    void refinePass(int level);
+
+    // Refines the region faces and rebuilds the patches of the control faces
+    // in patched (a subset of region) from the polygons they end up with
+    void refine(const std::vector<int> &region, const std::vector<int> &patched);
+
+    // Writes the given patches into their slots, or at the end of the
+    // buffers if they outgrew them. Returns false if there's no room left,
+    // in which case create() has to lay them out again.
+    bool upload(const std::vector<int> &changed);
+
+public:
+    AdaptiveSubdivision(OpenGLContext *context);
+
+    // The deepest level any face is allowed to reach
+    int maxLevel;
+
+    // The on-screen edge length (in pixels) that faces are refined down to
+    float targetEdgePixels;
+
+    // How far (in levels) the projected size has to move past a level boundary
+    // before a face switches level. Stops faces popping back and forth.
+    float hysteresis;
+
+    // Sets the control mesh and forces a rebuild on the next update()
+    void setSource(Mesh *mesh);
+
+    // Marks the refinement as stale after the control mesh was edited
+    void invalidate();
+
+    // Re-evaluates the face levels for the given camera. Only the faces whose
+    // level changed, and the neighbours whose refinement depends on them, are
+    // refined again, and their patches are rewritten in place. Returns true
+    // if the buffers have to be recreated instead, after the control mesh
+    // changed or once the patches no longer fit.
+    bool update(Camera &cam);
+
+    // Number of triangles in the refined mesh
+    int triangleCount();
+
+    void create() override;
+};
+
+#endif // ADAPTIVESUBDIVISION_H
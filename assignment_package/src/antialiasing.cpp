@@ -0,0 +1,141 @@
+#include "antialiasing.h"
+#include <iostream>
+#include <algorithm>
+
+AntiAliasing::AntiAliasing(OpenGLContext *context)
+    : mode(FXAA), samples(4), context(context), width(0), height(0), allocated(false),
+      fbo(0), colour(0), depth(0), fxaa(context), fxaaCreated(false), emptyVao(0)
+{}
+
+const char *AntiAliasing::name(Mode m)
+{
+    return m == MSAA ? "MSAA" : m == FXAA ? "FXAA" : "none";
+}
+
+void AntiAliasing::setMode(Mode m)
+{
+    release();
+    mode = m;
+}
+
+void AntiAliasing::resize(int w, int h)
+{
+    if (w != width || h != height){
+        release();
+        width = w;
+        height = h;
+    }
+}
+
+void AntiAliasing::allocate()
+{
+    allocated = true;
+    if (mode == NONE || width <= 0 || height <= 0){
+        return;
+    }
+
+    context->glGenFramebuffers(1, &fbo);
+    context->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    context->glGenRenderbuffers(1, &depth);
+    context->glBindRenderbuffer(GL_RENDERBUFFER, depth);
+
+    if (mode == MSAA){
+        GLint maxSamples = 0;
+        context->glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        int n = std::min(samples, int(maxSamples));
+        context->glRenderbufferStorageMultisample(GL_RENDERBUFFER, n, GL_DEPTH_COMPONENT24, width, height);
+        context->glGenRenderbuffers(1, &colour);
+        context->glBindRenderbuffer(GL_RENDERBUFFER, colour);
+        context->glRenderbufferStorageMultisample(GL_RENDERBUFFER, n, GL_RGBA8, width, height);
+        context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colour);
+    } else {
+        context->glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        // The post pass samples between texels along the edges, so the
+        // texture is filtered
+        context->glActiveTexture(GL_TEXTURE0);
+        context->glGenTextures(1, &colour);
+        context->glBindTexture(GL_TEXTURE_2D, colour);
+        context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        context->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colour, 0);
+
+        if (!fxaaCreated){
+            fxaa.create(":/glsl/fxaa.vert.glsl", ":/glsl/fxaa.frag.glsl");
+            context->glGenVertexArrays(1, &emptyVao);
+            fxaaCreated = true;
+        }
+    }
+    context->glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    // Without a complete framebuffer the frames are drawn as they are
+    GLenum status = context->glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE){
+        std::cerr << "No " << name(mode) << " framebuffer (status 0x" << std::hex << status << std::dec
+                  << "), drawing without antialiasing" << std::endl;
+        release();
+        mode = NONE;
+        allocated = true;
+    }
+}
+
+void AntiAliasing::release()
+{
+    if (fbo){
+        context->glDeleteFramebuffers(1, &fbo);
+        context->glDeleteRenderbuffers(1, &depth);
+        if (mode == MSAA){
+            context->glDeleteRenderbuffers(1, &colour);
+        } else {
+            context->glDeleteTextures(1, &colour);
+        }
+    }
+    fbo = colour = depth = 0;
+    allocated = false;
+}
+
+void AntiAliasing::begin()
+{
+    if (!allocated){
+        allocate();
+    }
+    if (fbo){
+        context->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    }
+}
+
+void AntiAliasing::end(GLuint target)
+{
+    if (!fbo){
+        return;
+    }
+
+    if (mode == MSAA){
+        context->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        context->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+        context->glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        context->glBindFramebuffer(GL_FRAMEBUFFER, target);
+    } else {
+        // One triangle over the whole screen, which needs no depth test
+        context->glBindFramebuffer(GL_FRAMEBUFFER, target);
+        context->glDisable(GL_DEPTH_TEST);
+        context->glActiveTexture(GL_TEXTURE0);
+        context->glBindTexture(GL_TEXTURE_2D, colour);
+        fxaa.useMe();
+        context->glBindVertexArray(emptyVao);
+        context->glDrawArrays(GL_TRIANGLES, 0, 3);
+        context->glBindVertexArray(0);
+        context->glEnable(GL_DEPTH_TEST);
+    }
+    context->printGLErrorLog();
+}
+
+void AntiAliasing::destroy()
+{
+    release();
+    context->glDeleteVertexArrays(1, &emptyVao);
+    emptyVao = 0;
+    fxaaCreated = false;
+}
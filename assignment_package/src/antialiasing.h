@@ -0,0 +1,72 @@
+#ifndef ANTIALIASING_H
+#define ANTIALIASING_H
+
+#include <openglcontext.h>
+#include <shaderprogram.h>
+
+// Antialiasing for the frames MyGL draws, in place of GL_POLYGON_SMOOTH,
+// which most drivers (software ones especially) run very slowly and which
+// leaves seams between the triangles of a face. The frame is drawn into an
+// offscreen framebuffer of the widget's size, and end() resolves it into the
+// widget's own:
+//  * MSAA: multisampled colour and depth, resolved with glBlitFramebuffer.
+//    Edges of triangles, lines and points are all smoothed.
+//  * FXAA: a single sampled colour texture, smoothed by a post pass that
+//    blurs along the edges it finds by luma contrast. About the cost of one
+//    fullscreen draw, so far cheaper than MSAA where fill rate is short.
+// Unlike QSurfaceFormat::setSamples, the mode can be switched while running.
+class AntiAliasing
+{
+public:
+    enum Mode {
+        NONE, // drawn straight into the widget's framebuffer
+        MSAA,
+        FXAA
+    };
+
+    AntiAliasing(OpenGLContext *context);
+
+    // The mode frames are drawn with, FXAA to begin with
+    Mode mode;
+
+    // The samples MSAA asks for, capped at GL_MAX_SAMPLES
+    int samples;
+
+    // Switches the mode, releasing the framebuffer of the old one. Needs a
+    // current context.
+    void setMode(Mode m);
+
+    // Sets the size of the framebuffer in device pixels, which is reallocated
+    // on the next begin()
+    void resize(int w, int h);
+
+    // Binds the framebuffer the frame is drawn into, allocating it first if
+    // the size or mode changed
+    void begin();
+
+    // Resolves the frame into target, the framebuffer shown on screen
+    void end(GLuint target);
+
+    void destroy();
+
+    static const char *name(Mode m);
+
+private:
+    OpenGLContext *context;
+    int width;
+    int height;
+    bool allocated; // whether the buffers below match the mode and size
+
+    GLuint fbo;
+    GLuint colour;  // a renderbuffer for MSAA, a texture for FXAA
+    GLuint depth;   // a renderbuffer
+
+    ShaderProgram fxaa; // compiled the first time FXAA is used
+    bool fxaaCreated;
+    GLuint emptyVao;    // the post pass makes its fullscreen triangle from gl_VertexID alone
+
+    void allocate();
+    void release();
+};
+
+#endif // ANTIALIASING_H
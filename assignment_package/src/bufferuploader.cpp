@@ -0,0 +1,167 @@
+#include "bufferuploader.h"
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <iostream>
+
+bool BufferUploader::Upload::complete(QOpenGLFunctions_3_2_Core &gl)
+{
+    if (!finished.load() || dropped){
+        return false;
+    }
+    if (fence){
+        if (gl.glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED){
+            return false;
+        }
+        gl.glDeleteSync(fence);
+        fence = nullptr;
+    }
+    return true;
+}
+
+bool BufferUploader::Upload::ran() const
+{
+    return finished.load() && !dropped;
+}
+
+bool BufferUploader::Upload::done() const
+{
+    return finished.load();
+}
+
+void BufferUploader::Upload::discard(QOpenGLFunctions_3_2_Core &gl)
+{
+    if (fence){
+        gl.glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+BufferUploader::BufferUploader(OpenGLContext *widget)
+    : QThread(), widget(widget), context(nullptr), surface(nullptr),
+      mutex(), wake(), queue(), stopping(false)
+{}
+
+BufferUploader::~BufferUploader()
+{
+    stop();
+}
+
+void BufferUploader::init()
+{
+    QOpenGLContext *shared = widget->context();
+    surface = new QOffscreenSurface();
+    surface->setFormat(shared->format());
+    surface->create();
+
+    context = new QOpenGLContext();
+    context->setFormat(shared->format());
+    context->setShareContext(shared);
+    if (!surface->isValid() || !context->create() || !QOpenGLContext::areSharing(context, shared)
+            || !context->versionFunctions<QOpenGLFunctions_3_2_Core>()){
+        std::cerr << "No shared context for background uploads, uploading on the GUI thread" << std::endl;
+        delete context;
+        context = nullptr;
+        surface->destroy();
+        delete surface;
+        surface = nullptr;
+        return;
+    }
+
+    // A context can only be made current on the thread it belongs to
+    context->moveToThread(this);
+    stopping = false;
+    start();
+}
+
+void BufferUploader::stop()
+{
+    if (!context){
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        for (std::shared_ptr<Upload> &upload : queue){
+            upload->dropped = true;
+            upload->finished.store(true);
+        }
+        queue.clear();
+    }
+    wake.notify_all();
+    wait();
+
+    delete context;
+    context = nullptr;
+    surface->destroy();
+    delete surface;
+    surface = nullptr;
+}
+
+bool BufferUploader::threaded() const
+{
+    return context != nullptr;
+}
+
+std::shared_ptr<BufferUploader::Upload> BufferUploader::submit(std::function<void(QOpenGLFunctions_3_2_Core &)> work)
+{
+    std::shared_ptr<Upload> upload = std::make_shared<Upload>();
+    if (!context){
+        work(*widget);
+        upload->finished.store(true);
+        return upload;
+    }
+
+    upload->work = std::move(work);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(upload);
+    }
+    wake.notify_all();
+    return upload;
+}
+
+void BufferUploader::finish(const std::shared_ptr<Upload> &upload)
+{
+    if (!upload){
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [&upload]{ return upload->finished.load(); });
+}
+
+void BufferUploader::run()
+{
+    context->makeCurrent(surface);
+    QOpenGLFunctions_3_2_Core *gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
+    gl->initializeOpenGLFunctions();
+
+    for (;;){
+        std::shared_ptr<Upload> upload;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (stopping){
+                break;
+            }
+            upload = queue.front();
+            queue.pop_front();
+        }
+
+        upload->work(*gl);
+        upload->work = nullptr;
+        upload->fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // The other context can only wait on the fence once it has reached
+        // the GPU
+        gl->glFlush();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            upload->finished.store(true);
+        }
+        wake.notify_all();
+    }
+
+    // Handed back, so that stop() can delete it
+    context->doneCurrent();
+    context->moveToThread(widget->thread());
+}
@@ -0,0 +1,95 @@
+#ifndef BUFFERUPLOADER_H
+#define BUFFERUPLOADER_H
+
+#include <openglcontext.h>
+#include <QThread>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+class QOpenGLContext;
+class QOffscreenSurface;
+
+// A thread with an OpenGL context of its own, sharing buffers and textures
+// with the widget's, that creates and fills new buffers while the GUI thread
+// goes on drawing the old ones. Each piece of work is followed by a fence,
+// and the GUI thread only swaps the new buffers in once complete() finds the
+// fence signalled, so it never draws a buffer that's still being filled.
+//
+// Buffers are shared between the contexts, but VAOs aren't: the work only
+// creates buffers and textures, and ShaderProgram::draw sets the VAOs up on
+// the GUI thread as always.
+class BufferUploader : public QThread
+{
+public:
+    // A piece of work handed to submit(), and how far it got
+    class Upload
+    {
+    public:
+        // Whether the work has run and the GPU finished everything it
+        // issued, so its buffers can be drawn. Only called on the GUI thread,
+        // with gl the widget's context, which deletes the fence once it's
+        // signalled.
+        bool complete(QOpenGLFunctions_3_2_Core &gl);
+
+        // Whether the work has run, on whichever thread
+        bool ran() const;
+
+        // Whether the work has run or was dropped, so that nothing touches
+        // what it reads and writes any more
+        bool done() const;
+
+        // Deletes the fence of work that ran but won't be swapped in
+        void discard(QOpenGLFunctions_3_2_Core &gl);
+
+    private:
+        friend class BufferUploader;
+
+        std::function<void(QOpenGLFunctions_3_2_Core &)> work;
+        std::atomic<bool> finished{false}; // set once work ran, or was dropped by stop()
+        bool dropped = false;
+        GLsync fence = nullptr; // written by the worker before finished is set
+    };
+
+    BufferUploader(OpenGLContext *widget);
+    ~BufferUploader();
+
+    // Creates the worker's context and starts the thread. Needs the widget's
+    // context current. If the contexts can't share, every upload is run
+    // straight away by submit() instead.
+    void init();
+
+    // Stops the thread once the work it's running is done, dropping any
+    // still queued
+    void stop();
+
+    // Whether work is handed to the thread, rather than run by submit()
+    bool threaded() const;
+
+    // Queues work, which is called on the worker with its context current
+    // and gets the GL functions of that context. Without the thread it's run
+    // on the calling thread, with the widget's context.
+    std::shared_ptr<Upload> submit(std::function<void(QOpenGLFunctions_3_2_Core &)> work);
+
+    // Waits for the given work to have run (or been dropped), so that what
+    // it reads and writes can be touched again
+    void finish(const std::shared_ptr<Upload> &upload);
+
+protected:
+    void run() override;
+
+private:
+    OpenGLContext *widget;
+    QOpenGLContext *context;    // the worker's, current on the thread for as long as it runs
+    QOffscreenSurface *surface; // what the worker's context is made current on
+
+    std::mutex mutex;
+    std::condition_variable wake; // signalled when work is queued, or has run
+    std::deque<std::shared_ptr<Upload>> queue;
+    bool stopping;
+};
+
+#endif // BUFFERUPLOADER_H
@@ -0,0 +1,659 @@
+#include "decimation.h"
+#include <algorithm>
+#include <cmath>
+
+LODMesh::LODMesh(OpenGLContext *context)
+    : Drawable(context)
+{}
+
+int LODMesh::faceCount()
+{
+    return colours.size();
+}
+
+// The levels share their vertices between triangles, so they're uploaded
+// in the SHARED_VERTICES layout of Mesh: bare positions, and one colour per
+// triangle read through a buffer texture
+void LODMesh::create()
+{
+    std::vector<GLuint> faceCols(colours.size());
+    for (int t = 0; t < faceCount(); t++){
+        faceCols[t] = packColour(colours[t]);
+    }
+
+    count = tris.size();
+    layout = MeshBufferBuilder::vertexLayout(MeshBufferBuilder::SHARED_VERTICES, false);
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, tris.size() * sizeof(GLuint), tris.data(), GL_STATIC_DRAW);
+
+    generateVert();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufVert);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(glm::vec3), verts.data(), GL_STATIC_DRAW);
+
+    generateFaceCol();
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, bufFaceCol);
+    mp_context->glBufferData(GL_TEXTURE_BUFFER, faceCols.size() * sizeof(GLuint), faceCols.data(), GL_STATIC_DRAW);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, texFaceCol);
+    mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, bufFaceCol);
+}
+
+void EdgeQueue::resize(int size)
+{
+    heap.clear();
+    slot.assign(size, -1);
+    key.assign(size, 0.f);
+}
+
+bool EdgeQueue::empty()
+{
+    return heap.empty();
+}
+
+int EdgeQueue::top()
+{
+    return heap[0];
+}
+
+bool EdgeQueue::less(int i, int j)
+{
+    return key[heap[i]] < key[heap[j]];
+}
+
+void EdgeQueue::swapSlots(int i, int j)
+{
+    std::swap(heap[i], heap[j]);
+    slot[heap[i]] = i;
+    slot[heap[j]] = j;
+}
+
+void EdgeQueue::siftUp(int i)
+{
+    while (i > 0 && less(i, (i - 1) / 2)){
+        swapSlots(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+void EdgeQueue::siftDown(int i)
+{
+    int n = heap.size();
+    while (true){
+        int smallest = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+        if (l < n && less(l, smallest)){
+            smallest = l;
+        }
+        if (r < n && less(r, smallest)){
+            smallest = r;
+        }
+        if (smallest == i){
+            return;
+        }
+        swapSlots(i, smallest);
+        i = smallest;
+    }
+}
+
+void EdgeQueue::update(int e, float cost)
+{
+    key[e] = cost;
+    if (slot[e] < 0){
+        slot[e] = heap.size();
+        heap.push_back(e);
+        siftUp(slot[e]);
+    } else {
+        siftUp(slot[e]);
+        siftDown(slot[e]);
+    }
+}
+
+void EdgeQueue::remove(int e)
+{
+    int i = slot[e];
+    if (i < 0){
+        return;
+    }
+    swapSlots(i, heap.size() - 1);
+    heap.pop_back();
+    slot[e] = -1;
+    if (i < int(heap.size())){
+        siftUp(i);
+        siftDown(i);
+    }
+}
+
+int QuadricDecimator::next(int h)
+{
+    return h % 3 == 2 ? h - 2 : h + 1;
+}
+
+int QuadricDecimator::prev(int h)
+{
+    return h % 3 == 0 ? h + 2 : h - 1;
+}
+
+int QuadricDecimator::from(int h)
+{
+    return heVert[prev(h)];
+}
+
+// Adds the quadric of the plane through p with unit normal n, scaled by weight
+static void addPlane(double *q, const glm::vec3 &n, const glm::vec3 &p, double weight)
+{
+    double a = n.x, b = n.y, c = n.z;
+    double d = -glm::dot(n, p);
+    q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+    q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+    q[7] += weight * c * c; q[8] += weight * c * d;
+    q[9] += weight * d * d;
+}
+
+// Evaluates v^T Q v for v = (p, 1)
+static double quadricError(const double *q, const glm::dvec3 &p)
+{
+    return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x
+         + q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y
+         + q[7] * p.z * p.z + 2 * q[8] * p.z
+         + q[9];
+}
+
+QuadricDecimator::QuadricDecimator(Mesh &mesh)
+    : liveFaces(0), stamp(0)
+{
+    load(mesh);
+}
+
+int QuadricDecimator::faceCount()
+{
+    return liveFaces;
+}
+
+// Fans every face into triangles. Half edges of the source mesh keep their
+// twins through their iDs, and the diagonals added by the fan are paired up
+// directly, so no edge lookup table is needed.
+void QuadricDecimator::load(Mesh &mesh)
+{
+    int n = mesh.vertices.size();
+    unsigned int maxVertID = 0;
+    for (uPtr<Vertex> &v : mesh.vertices){
+        maxVertID = std::max(maxVertID, v->iD);
+    }
+    std::vector<int> vertIndex(maxVertID + 1);
+    pos.resize(n);
+    for (int i = 0; i < n; i++){
+        vertIndex[mesh.vertPtr(i)->iD] = i;
+        pos[i] = mesh.vertPtr(i)->pos;
+    }
+
+    unsigned int maxEdgeID = 0;
+    int triCount = 0;
+    for (uPtr<HalfEdge> &e : mesh.halfEdges){
+        maxEdgeID = std::max(maxEdgeID, e->iD);
+    }
+    for (uPtr<Face> &f : mesh.faces){
+        HalfEdge *e = f->edge;
+        do {
+            triCount++;
+            e = e->next;
+        } while (e != f->edge);
+        triCount -= 2;
+    }
+
+    std::vector<int> edgeIndex(maxEdgeID + 1, -1);
+    std::vector<HalfEdge*> corners;
+    heVert.reserve(3 * triCount);
+    twin.assign(3 * triCount, -1);
+    faceColour.reserve(triCount);
+    for (uPtr<Face> &f : mesh.faces){
+        // corners[i] is the half edge ending at corner i
+        corners.clear();
+        HalfEdge *e = f->edge;
+        do {
+            corners.push_back(e);
+            e = e->next;
+        } while (e != f->edge);
+
+        int m = corners.size();
+        int c0 = vertIndex[corners[0]->vert->iD];
+        for (int j = 1; j < m - 1; j++){
+            int t = faceColour.size();
+            // Half edge 3t + k runs from corner k to corner k + 1 of the
+            // triangle (c0, cj, cj+1)
+            heVert.push_back(vertIndex[corners[j]->vert->iD]);
+            heVert.push_back(vertIndex[corners[j + 1]->vert->iD]);
+            heVert.push_back(c0);
+            faceColour.push_back(f->colour);
+
+            edgeIndex[corners[j + 1]->iD] = 3 * t + 1;
+            if (j == 1){
+                edgeIndex[corners[1]->iD] = 3 * t;
+            } else {
+                twin[3 * t] = 3 * (t - 1) + 2;
+                twin[3 * (t - 1) + 2] = 3 * t;
+            }
+            if (j == m - 2){
+                edgeIndex[corners[0]->iD] = 3 * t + 2;
+            }
+        }
+    }
+    for (uPtr<HalfEdge> &e : mesh.halfEdges){
+        int h = edgeIndex[e->iD];
+        if (h >= 0 && e->sym != nullptr && e->sym->face != nullptr){
+            twin[h] = edgeIndex[e->sym->iD];
+        }
+    }
+
+    liveFaces = faceColour.size();
+    faceDead.assign(liveFaces, 0);
+    vertDead.assign(n, 0);
+    locked.assign(n, 0);
+    vertEdge.assign(n, -1);
+    mark.assign(n, 0);
+    quadrics.assign(n, Quadric{});
+    target.resize(heVert.size());
+
+    std::vector<int> incoming(n, 0);
+    for (int h = 0; h < int(heVert.size()); h++){
+        vertEdge[heVert[h]] = h;
+        incoming[heVert[h]]++;
+        if (twin[h] < 0){
+            locked[heVert[h]] = 1;
+            locked[from(h)] = 1;
+        }
+    }
+
+    // A vertex whose triangles form more than one fan can't be walked around
+    // from vertEdge alone, so collapses never touch it
+    for (int v = 0; v < n; v++){
+        if (locked[v] || vertEdge[v] < 0){
+            continue;
+        }
+        int fan = 0;
+        int g = vertEdge[v];
+        do {
+            fan++;
+            g = twin[next(g)];
+        } while (g != vertEdge[v]);
+        if (fan != incoming[v]){
+            locked[v] = 1;
+        }
+    }
+
+    // Every vertex starts with the area weighted planes of its triangles
+    for (int t = 0; t < liveFaces; t++){
+        int a = heVert[3 * t + 2], b = heVert[3 * t], c = heVert[3 * t + 1];
+        glm::vec3 normal = glm::cross(pos[b] - pos[a], pos[c] - pos[a]);
+        float area = glm::length(normal);
+        if (area <= 0.f){
+            continue;
+        }
+        normal /= area;
+        for (int v : {a, b, c}){
+            addPlane(quadrics[v].q, normal, pos[a], 0.5 * area);
+        }
+    }
+
+    queue.resize(heVert.size());
+    for (int h = 0; h < int(heVert.size()); h++){
+        if (twin[h] > h){
+            queueEdge(h);
+        }
+    }
+}
+
+// The target minimizes the summed quadric when its 3x3 part is invertible;
+// otherwise the better of the two endpoints and the midpoint is used
+void QuadricDecimator::queueEdge(int h)
+{
+    int e = std::min(h, twin[h]);
+    int v0 = from(e);
+    int v1 = heVert[e];
+    if (locked[v0] || locked[v1]){
+        queue.remove(e);
+        return;
+    }
+
+    double q[10];
+    for (int i = 0; i < 10; i++){
+        q[i] = quadrics[v0].q[i] + quadrics[v1].q[i];
+    }
+
+    double det = q[0] * (q[4] * q[7] - q[5] * q[5])
+               - q[1] * (q[1] * q[7] - q[5] * q[2])
+               + q[2] * (q[1] * q[5] - q[4] * q[2]);
+    glm::dvec3 best;
+    double error;
+    if (std::abs(det) > 1e-12){
+        // Cramer's rule on A x = -b
+        double bx = -q[3], by = -q[6], bz = -q[8];
+        best.x = (bx * (q[4] * q[7] - q[5] * q[5]) - q[1] * (by * q[7] - q[5] * bz) + q[2] * (by * q[5] - q[4] * bz)) / det;
+        best.y = (q[0] * (by * q[7] - q[5] * bz) - bx * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * bz - by * q[2])) / det;
+        best.z = (q[0] * (q[4] * bz - by * q[5]) - q[1] * (q[1] * bz - by * q[2]) + bx * (q[1] * q[5] - q[4] * q[2])) / det;
+        error = quadricError(q, best);
+    } else {
+        glm::dvec3 p0(pos[v0]);
+        glm::dvec3 p1(pos[v1]);
+        error = INFINITY;
+        for (const glm::dvec3 &p : {p0, p1, (p0 + p1) * 0.5}){
+            double pError = quadricError(q, p);
+            if (pError < error){
+                error = pError;
+                best = p;
+            }
+        }
+    }
+
+    target[e] = glm::vec3(best);
+    queue.update(e, std::max(0.0, error));
+}
+
+bool QuadricDecimator::canCollapse(int h, const glm::vec3 &p)
+{
+    int t = twin[h];
+    int v0 = from(h);
+    int v1 = heVert[h];
+    int a = heVert[next(h)];
+    int b = heVert[next(t)];
+    if (a == b){
+        return false;
+    }
+
+    // Link condition: v0 and v1 may only share the two neighbours opposite
+    // the edge, otherwise the collapse pinches the surface
+    stamp++;
+    int valence0 = 0;
+    int g = vertEdge[v0];
+    do {
+        mark[from(g)] = stamp;
+        valence0++;
+        g = twin[next(g)];
+    } while (g != vertEdge[v0]);
+    int shared = 0;
+    int valence1 = 0;
+    g = vertEdge[v1];
+    do {
+        if (mark[from(g)] == stamp){
+            shared++;
+        }
+        valence1++;
+        g = twin[next(g)];
+    } while (g != vertEdge[v1]);
+    if (shared != 2){
+        return false;
+    }
+
+    // A tetrahedron passes the link condition but would collapse into two
+    // triangles glued back to back
+    if (valence0 == 3 && valence1 == 3){
+        return false;
+    }
+
+    // No remaining triangle around either endpoint may turn by more than
+    // about 80 degrees or become degenerate
+    for (int v : {v0, v1}){
+        g = vertEdge[v];
+        do {
+            int f = g / 3;
+            if (f != h / 3 && f != t / 3){
+                const glm::vec3 &pa = pos[from(g)];
+                const glm::vec3 &pb = pos[heVert[next(g)]];
+                glm::vec3 before = glm::cross(pos[v] - pa, pb - pa);
+                glm::vec3 after = glm::cross(p - pa, pb - pa);
+                float lenBefore = glm::length(before);
+                float lenAfter = glm::length(after);
+                if (lenAfter <= 1e-12f || glm::dot(before, after) < 0.2f * lenBefore * lenAfter){
+                    return false;
+                }
+            }
+            g = twin[next(g)];
+        } while (g != vertEdge[v]);
+    }
+    return true;
+}
+
+void QuadricDecimator::collapse(int h, const glm::vec3 &p)
+{
+    int t = twin[h];
+    int v0 = from(h);
+    int v1 = heVert[h];
+    int hn = next(h), hp = prev(h);
+    int tn = next(t), tp = prev(t);
+    int a = heVert[hn];
+    int b = heVert[tn];
+
+    // The outer edges of the two triangles that disappear
+    int o1 = twin[hn];  // a -> v1
+    int o2 = twin[hp];  // v0 -> a
+    int o3 = twin[tn];  // b -> v0
+    int o4 = twin[tp];  // v1 -> b
+
+    for (int e : {h, hn, hp, tn, tp}){
+        queue.remove(std::min(e, twin[e]));
+    }
+
+    // Every half edge ending at v0 now ends at v1
+    int g = vertEdge[v0];
+    do {
+        heVert[g] = v1;
+        g = twin[next(g)];
+    } while (g != vertEdge[v0]);
+
+    twin[o1] = o2;
+    twin[o2] = o1;
+    twin[o3] = o4;
+    twin[o4] = o3;
+
+    faceDead[h / 3] = 1;
+    faceDead[t / 3] = 1;
+    liveFaces -= 2;
+    vertDead[v0] = 1;
+
+    vertEdge[v1] = o1;
+    vertEdge[a] = o2;
+    vertEdge[b] = o4;
+
+    pos[v1] = p;
+    for (int i = 0; i < 10; i++){
+        quadrics[v1].q[i] += quadrics[v0].q[i];
+    }
+
+    // Only edges touching v1 change cost
+    g = vertEdge[v1];
+    do {
+        queueEdge(g);
+        g = twin[next(g)];
+    } while (g != vertEdge[v1]);
+}
+
+// Edges that fail the validity checks are dropped from the queue; they come
+// back once a collapse next to them recomputes their cost
+int QuadricDecimator::decimateTo(int targetFaces)
+{
+    while (liveFaces > targetFaces && !queue.empty()){
+        int h = queue.top();
+        if (canCollapse(h, target[h])){
+            collapse(h, target[h]);
+        } else {
+            queue.remove(h);
+        }
+    }
+    return liveFaces;
+}
+
+void QuadricDecimator::extract(LODMesh &lod)
+{
+    lod.verts.clear();
+    lod.tris.clear();
+    lod.colours.clear();
+
+    std::vector<int> remap(pos.size(), -1);
+    for (int v = 0; v < int(pos.size()); v++){
+        if (!vertDead[v]){
+            remap[v] = lod.verts.size();
+            lod.verts.push_back(pos[v]);
+        }
+    }
+    lod.tris.reserve(3 * liveFaces);
+    lod.colours.reserve(liveFaces);
+    for (int t = 0; t < int(faceDead.size()); t++){
+        if (faceDead[t]){
+            continue;
+        }
+        // Corner k of triangle t is where half edge 3t + k - 1 ends
+        lod.tris.push_back(remap[heVert[3 * t + 2]]);
+        lod.tris.push_back(remap[heVert[3 * t]]);
+        lod.tris.push_back(remap[heVert[3 * t + 1]]);
+        lod.colours.push_back(faceColour[t]);
+    }
+}
+
+LODChain::LODChain(OpenGLContext *context)
+    : context(context), center(0.f), radius(1.f), source(nullptr), levelCount(0), ratio(0.f),
+      stale(false), worker(), rebuilt(false), pendingLevels(), pendingCenter(0.f), pendingRadius(1.f),
+      fullDetailDistance(6.f)
+{}
+
+LODChain::~LODChain()
+{
+    if (worker.joinable()){
+        worker.join();
+    }
+}
+
+void LODChain::bounds(Mesh &mesh, glm::vec3 &center, float &radius)
+{
+    glm::vec3 lo = mesh.vertPtr(0)->pos;
+    glm::vec3 hi = lo;
+    for (uPtr<Vertex> &v : mesh.vertices){
+        lo = glm::min(lo, v->pos);
+        hi = glm::max(hi, v->pos);
+    }
+    center = (lo + hi) * 0.5f;
+    radius = std::max(glm::length(hi - lo) * 0.5f, 1e-6f);
+}
+
+void LODChain::decimate(QuadricDecimator &decimator, std::vector<uPtr<LODMesh>> &lods, float ratio)
+{
+    int faces = decimator.faceCount();
+    size_t filled = 0;
+    while (filled < lods.size()){
+        int goal = faces * ratio;
+        if (goal < 4){
+            break;
+        }
+        faces = decimator.decimateTo(goal);
+        decimator.extract(*lods[filled]);
+        filled++;
+    }
+    lods.resize(filled);
+}
+
+void LODChain::build(Mesh &mesh, int levelCount, float ratio)
+{
+    clear();
+    source = &mesh;
+    this->levelCount = levelCount;
+    this->ratio = ratio;
+    if (mesh.vertices.empty()){
+        return;
+    }
+    bounds(mesh, center, radius);
+
+    QuadricDecimator decimator(mesh);
+    for (int i = 0; i < levelCount; i++){
+        levels.push_back(mkU<LODMesh>(context));
+    }
+    decimate(decimator, levels, ratio);
+    for (uPtr<LODMesh> &lod : levels){
+        lod->create();
+    }
+}
+
+void LODChain::startRebuild()
+{
+    levels.clear();
+    stale = false;
+    if (source->vertices.empty()){
+        return;
+    }
+    bounds(*source, pendingCenter, pendingRadius);
+
+    // The decimator copies what it needs of the mesh up front, so the worker
+    // never reads the mesh being edited. The levels are made here, since
+    // they're destroyed on this thread as well.
+    uPtr<QuadricDecimator> decimator = mkU<QuadricDecimator>(*source);
+    for (int i = 0; i < levelCount; i++){
+        pendingLevels.push_back(mkU<LODMesh>(context));
+    }
+    rebuilt = false;
+    worker = std::thread([this, decimator = std::move(decimator)](){
+        decimate(*decimator, pendingLevels, ratio);
+        rebuilt = true;
+    });
+}
+
+void LODChain::finishRebuild(bool keep)
+{
+    worker.join();
+    if (keep){
+        levels = std::move(pendingLevels);
+        center = pendingCenter;
+        radius = pendingRadius;
+        for (uPtr<LODMesh> &lod : levels){
+            lod->create();
+        }
+    }
+    pendingLevels.clear();
+}
+
+bool LODChain::rebuilding() const
+{
+    return worker.joinable();
+}
+
+void LODChain::clear()
+{
+    if (worker.joinable()){
+        finishRebuild(false);
+    }
+    levels.clear();
+    source = nullptr;
+    stale = false;
+}
+
+void LODChain::invalidate()
+{
+    stale = source != nullptr;
+}
+
+LODMesh *LODChain::select(Camera &cam)
+{
+    // Levels rebuilt for an older topology are still better than none, and a
+    // later select() starts over from the current one if need be
+    if (worker.joinable() && rebuilt){
+        finishRebuild(true);
+    }
+
+    float distance = glm::length(cam.eye - center) / radius;
+    int level = 0;
+    if (distance > fullDetailDistance){
+        level = 1 + std::floor(std::log2(distance / fullDetailDistance));
+    }
+    if (level == 0){
+        return nullptr;
+    }
+
+    // Only rebuilt once a coarse level is actually wanted, so a run of edits
+    // made up close costs one decimation at most
+    if (stale && !worker.joinable()){
+        startRebuild();
+    }
+    if (worker.joinable()){
+        return nullptr;
+    }
+    level = std::min<int>(level, levels.size());
+    return level == 0 ? nullptr : levels[level - 1].get();
+}
@@ -0,0 +1,200 @@
+#ifndef DECIMATION_H
+#define DECIMATION_H
+
+#include <drawable.h>
+#include <mesh.h>
+#include <camera.h>
+#include <smartpointerhelp.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// One level of detail produced by QuadricDecimator. Drawn like Mesh with
+// shared vertices, flat shaded in the colour of the face each triangle came
+// from.
+class LODMesh : public Drawable
+{
+public:
+    LODMesh(OpenGLContext *context);
+
+    std::vector<glm::vec3> verts;
+    std::vector<GLuint> tris;        // three indices into verts per triangle
+    std::vector<glm::vec3> colours;  // one per triangle
+
+    int faceCount();
+
+    void create() override;
+};
+
+// A binary min-heap of edges keyed by collapse cost that also tracks where each
+// edge sits, so costs can be changed and edges removed in O(log n) as collapses
+// reshape their neighbourhoods.
+class EdgeQueue
+{
+private:
+    std::vector<int> heap;  // edges ordered by cost
+    std::vector<int> slot;  // position of every edge in heap, or -1 if it isn't queued
+    std::vector<float> key;
+
+    bool less(int i, int j);
+    void swapSlots(int i, int j);
+    void siftUp(int i);
+    void siftDown(int i);
+
+public:
+    // Makes room for edges 0 to size - 1
+    void resize(int size);
+
+    bool empty();
+    int top();
+
+    // Queues edge e with the given cost, or moves it if it's already queued
+    void update(int e, float cost);
+    void remove(int e);
+};
+
+// Quadric error metric edge-collapse decimation (Garland and Heckbert). The
+// source mesh is triangulated into a compact, index based half-edge copy, so
+// the collapses never touch the editable Mesh or its list items. Vertices on
+// a boundary are never moved, which keeps holes and open borders in place.
+// Non-manifold vertices are left alone as well.
+class QuadricDecimator
+{
+private:
+    // A symmetric 4x4 error quadric stored as its upper triangle:
+    // a2 ab ac ad b2 bc bd c2 cd d2
+    struct Quadric {
+        double q[10];
+    };
+
+    std::vector<glm::vec3> pos;
+    std::vector<Quadric> quadrics;
+    std::vector<int> vertEdge;     // a half edge ending at each vertex
+    std::vector<char> locked;      // boundary and non-manifold vertices, which are never moved
+    std::vector<char> vertDead;
+
+    // Half edge 3t + k belongs to triangle t. heVert holds the vertex each
+    // half edge points to, and twin is -1 on the boundary.
+    std::vector<int> heVert;
+    std::vector<int> twin;
+    std::vector<char> faceDead;
+    std::vector<glm::vec3> faceColour;
+    int liveFaces;
+
+    // The queue holds one half edge per edge (the one with the lower index),
+    // and target stores the position the edge collapses to
+    EdgeQueue queue;
+    std::vector<glm::vec3> target;
+
+    // Stamps used to mark the one-ring during the link condition test
+    std::vector<int> mark;
+    int stamp;
+
+    static int next(int h);
+    static int prev(int h);
+    int from(int h);
+
+    void load(Mesh &mesh);
+
+    // Computes the cost and target of the edge h belongs to and (re)queues it
+    void queueEdge(int h);
+
+    // Checks that collapsing h to p keeps the mesh manifold and doesn't flip
+    // any of the surrounding triangles
+    bool canCollapse(int h, const glm::vec3 &p);
+
+    // Merges the start of h into its end, which is moved to p
+    void collapse(int h, const glm::vec3 &p);
+
+public:
+    QuadricDecimator(Mesh &mesh);
+
+    // Collapses the cheapest valid edges until at most targetFaces triangles
+    // are left. Returns the triangle count reached, which stays above
+    // targetFaces if no valid collapse is left.
+    int decimateTo(int targetFaces);
+
+    int faceCount();
+
+    // Copies the triangles that are still alive into lod
+    void extract(LODMesh &lod);
+};
+
+// A chain of increasingly coarse versions of a mesh, picked by how far the
+// camera is from it
+class LODChain
+{
+private:
+    OpenGLContext *context;
+
+    // Bounding sphere of the source mesh
+    glm::vec3 center;
+    float radius;
+
+    // What the last build() decimated and how, so a stale chain can be
+    // built again the same way
+    Mesh *source;
+    int levelCount;
+    float ratio;
+
+    // Set when the source mesh's topology changed since the levels were built
+    bool stale;
+
+    // A stale chain is decimated again on worker, from a copy taken when
+    // select() first wanted a coarse level, and the source mesh is drawn
+    // until it's done. The levels are only created, and swapped in, on the
+    // GUI thread, once rebuilt is set.
+    std::thread worker;
+    std::atomic<bool> rebuilt;
+    std::vector<uPtr<LODMesh>> pendingLevels;
+    glm::vec3 pendingCenter;
+    float pendingRadius;
+
+    // Bounding sphere of mesh's vertices
+    static void bounds(Mesh &mesh, glm::vec3 &center, float &radius);
+
+    // Fills lods with successively coarser versions of the decimator's mesh,
+    // ratio times the triangles of the one before, until one would have too
+    // few. Drops the ones left empty. Touches no OpenGL state.
+    static void decimate(QuadricDecimator &decimator, std::vector<uPtr<LODMesh>> &lods, float ratio);
+
+    void startRebuild();
+
+    // Waits for the worker, then creates and swaps in its levels if keep is
+    // set, or drops them
+    void finishRebuild(bool keep);
+
+public:
+    LODChain(OpenGLContext *context);
+    ~LODChain();
+
+    // levels[i] has about ratio^(i + 1) of the source mesh's triangles
+    std::vector<uPtr<LODMesh>> levels;
+
+    // The camera distance, in bounding radii, up to which the source mesh is
+    // drawn. Every doubling of the distance past it moves one level coarser.
+    float fullDetailDistance;
+
+    // Decimates mesh into levelCount levels, each with ratio times the
+    // triangles of the one before, and creates their buffers
+    void build(Mesh &mesh, int levelCount = 4, float ratio = 0.25f);
+
+    // Drops all levels, along with a rebuild in progress, and forgets the
+    // source mesh
+    void clear();
+
+    // Marks the levels out of date after the source mesh's topology changed.
+    // They're dropped and built again in the background once select() wants
+    // one of them. Moving vertices doesn't call for this, the coarse levels
+    // only stand in for the mesh from far away.
+    void invalidate();
+
+    // Returns the level to draw for the camera, or nullptr if the source mesh
+    // itself should be drawn, as it is while the levels are rebuilt
+    LODMesh *select(Camera &cam);
+
+    // Whether a rebuild is running, so select() should be asked again soon
+    bool rebuilding() const;
+};
+
+#endif // DECIMATION_H
@@ -2,9 +2,12 @@
 #include <la.h>
 
 Drawable::Drawable(OpenGLContext* context)
-    : count(-1), bufIdx(), bufPos(), bufNor(), bufCol(), bufJnt(), bufInf(),
+    : count(-1), bufIdx(), bufPos(), bufNor(), bufCol(), bufJnt(), bufInf(), bufVert(),
+      bufFaceCol(), texFaceCol(), bufInst(), texInst(),
       idxBound(false), posBound(false), norBound(false), colBound(false),
-      jntBound(false), infBound(false),
+      jntBound(false), infBound(false), vertBound(false), faceColBound(false),
+      instBound(false), vertShared(false), geometryShared(false), vertStreamed(false), instStreamed(false),
+      vertStream(context), instStream(context), vertBase(0), instBase(0), instances(0), ranged(false),
       mp_context(context)
 {}
 
@@ -15,12 +18,39 @@ Drawable::~Drawable() {
 
 void Drawable::destroy()
 {
-    mp_context->glDeleteBuffers(1, &bufIdx);
+    dropVaos();
+    if (!geometryShared){
+        mp_context->glDeleteBuffers(1, &bufIdx);
+        mp_context->glDeleteBuffers(1, &bufFaceCol);
+        mp_context->glDeleteTextures(1, &texFaceCol);
+    }
+    bufIdx = bufFaceCol = texFaceCol = 0;
+    geometryShared = false;
     mp_context->glDeleteBuffers(1, &bufPos);
     mp_context->glDeleteBuffers(1, &bufNor);
     mp_context->glDeleteBuffers(1, &bufCol);
     mp_context->glDeleteBuffers(1, &bufJnt);
     mp_context->glDeleteBuffers(1, &bufInf);
+    if (!vertShared && !vertStreamed){
+        mp_context->glDeleteBuffers(1, &bufVert);
+    }
+    bufVert = 0;
+    vertShared = vertStreamed = false;
+    vertStream.destroy();
+    if (!instStreamed){
+        mp_context->glDeleteBuffers(1, &bufInst);
+    }
+    bufInst = 0;
+    instStreamed = false;
+    instStream.destroy();
+    mp_context->glDeleteTextures(1, &texInst);
+    vertBase = instBase = 0;
+
+    // A later create() may use a different set of buffers
+    idxBound = posBound = norBound = colBound = false;
+    jntBound = infBound = vertBound = faceColBound = instBound = false;
+    instances = 0;
+    drawAll();
 }
 
 GLenum Drawable::drawMode()
@@ -39,8 +69,52 @@ int Drawable::elemCount()
     return count;
 }
 
+int Drawable::instanceCount()
+{
+    return instances;
+}
+
+void Drawable::drawRanges(const std::vector<std::pair<int, int>> &ranges)
+{
+    ranged = true;
+    rangeFirst.clear();
+    rangeIndices.clear();
+    rangeOffsets.clear();
+    for (const std::pair<int, int> &r : ranges){
+        rangeFirst.push_back(r.first);
+        rangeIndices.push_back(3 * r.second);
+        rangeOffsets.push_back(reinterpret_cast<const GLvoid*>(3 * r.first * sizeof(GLuint)));
+    }
+}
+
+void Drawable::drawAll()
+{
+    ranged = false;
+}
+
+int Drawable::rangeCount()
+{
+    return ranged ? int(rangeFirst.size()) : -1;
+}
+
+int Drawable::rangeTriangle(int i)
+{
+    return rangeFirst[i];
+}
+
+const GLsizei *Drawable::rangeCounts()
+{
+    return rangeIndices.data();
+}
+
+const GLvoid *const *Drawable::rangeStarts()
+{
+    return rangeOffsets.data();
+}
+
 void Drawable::generateIdx()
 {
+    dropVaos();
     idxBound = true;
     // Create a VBO on our GPU and store its handle in bufIdx
     mp_context->glGenBuffers(1, &bufIdx);
@@ -48,6 +122,7 @@ void Drawable::generateIdx()
 
 void Drawable::generatePos()
 {
+    dropVaos();
     posBound = true;
     // Create a VBO on our GPU and store its handle in bufPos
     mp_context->glGenBuffers(1, &bufPos);
@@ -55,6 +130,7 @@ void Drawable::generatePos()
 
 void Drawable::generateNor()
 {
+    dropVaos();
     norBound = true;
     // Create a VBO on our GPU and store its handle in bufNor
     mp_context->glGenBuffers(1, &bufNor);
@@ -62,6 +138,7 @@ void Drawable::generateNor()
 
 void Drawable::generateCol()
 {
+    dropVaos();
     colBound = true;
     // Create a VBO on our GPU and store its handle in bufCol
     mp_context->glGenBuffers(1, &bufCol);
@@ -69,6 +146,7 @@ void Drawable::generateCol()
 
 void Drawable::generateJnt()
 {
+    dropVaos();
     jntBound = true;
     // Create a VBO on our GPU and store its handle in bufJnt
     mp_context->glGenBuffers(1, &bufJnt);
@@ -76,11 +154,139 @@ void Drawable::generateJnt()
 
 void Drawable::generateInf()
 {
+    dropVaos();
     infBound = true;
     // Create a VBO on our GPU and store its handle in bufInf
     mp_context->glGenBuffers(1, &bufInf);
 }
 
+void Drawable::generateVert()
+{
+    dropVaos();
+    vertBound = true;
+    vertShared = vertStreamed = false;
+    vertStream.destroy();
+    vertBase = 0;
+    // Create a VBO on our GPU and store its handle in bufVert
+    mp_context->glGenBuffers(1, &bufVert);
+}
+
+void Drawable::shareVert(Drawable &other)
+{
+    dropVaos();
+    if (!vertShared && !vertStreamed){
+        mp_context->glDeleteBuffers(1, &bufVert);
+    }
+    vertStreamed = false;
+    vertStream.destroy();
+    vertBase = 0;
+    vertShared = true;
+    vertBound = other.vertBound;
+    bufVert = other.bufVert;
+    layout = other.layout;
+}
+
+void Drawable::shareGeometry(Drawable &other)
+{
+    shareVert(other);
+    if (!geometryShared){
+        mp_context->glDeleteBuffers(1, &bufIdx);
+        mp_context->glDeleteBuffers(1, &bufFaceCol);
+        mp_context->glDeleteTextures(1, &texFaceCol);
+    }
+    geometryShared = true;
+    count = other.count;
+    idxBound = other.idxBound;
+    bufIdx = other.bufIdx;
+    faceColBound = other.faceColBound;
+    bufFaceCol = other.bufFaceCol;
+    texFaceCol = other.texFaceCol;
+}
+
+void Drawable::generateFaceCol()
+{
+    faceColBound = true;
+    // Create a VBO for the colours and a buffer texture the shaders read them through
+    mp_context->glGenBuffers(1, &bufFaceCol);
+    mp_context->glGenTextures(1, &texFaceCol);
+}
+
+void Drawable::generateInst()
+{
+    instBound = true;
+    // Create a VBO for the instance data and a buffer texture the shaders read it through
+    mp_context->glGenBuffers(1, &bufInst);
+    mp_context->glGenTextures(1, &texInst);
+}
+
+void *Drawable::streamVert(const VertexLayout &l, int vertexCount)
+{
+    void *memory = vertStream.map(GL_ARRAY_BUFFER, vertexCount * l.stride, l.stride);
+    // The VAOs name the buffer, which changes whenever the stream outgrows it
+    if (!vertStreamed || bufVert != vertStream.buffer()){
+        dropVaos();
+        if (!vertStreamed && !vertShared){
+            mp_context->glDeleteBuffers(1, &bufVert);
+        }
+        vertBound = vertStreamed = true;
+        vertShared = false;
+        bufVert = vertStream.buffer();
+    }
+    layout = l;
+    return memory;
+}
+
+void Drawable::unmapVert()
+{
+    vertBase = vertStream.unmap();
+}
+
+void *Drawable::streamInst(int texels)
+{
+    void *memory = instStream.map(GL_TEXTURE_BUFFER, texels * sizeof(glm::vec4), sizeof(glm::vec4));
+    if (!instStreamed){
+        if (instBound){
+            mp_context->glDeleteBuffers(1, &bufInst);
+        } else {
+            mp_context->glGenTextures(1, &texInst);
+        }
+        bufInst = 0;
+        instBound = instStreamed = true;
+    }
+    // The texture is pointed at the whole buffer, every region of it
+    if (bufInst != instStream.buffer()){
+        bufInst = instStream.buffer();
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, texInst);
+        mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bufInst);
+    }
+    return memory;
+}
+
+void Drawable::unmapInst()
+{
+    instBase = instStream.unmap();
+}
+
+int Drawable::baseVertex()
+{
+    return vertBase;
+}
+
+int Drawable::instanceBase()
+{
+    return instBase;
+}
+
+void Drawable::fenceStreams()
+{
+    if (vertStreamed){
+        vertStream.fence();
+    }
+    if (instStreamed){
+        instStream.fence();
+    }
+}
+
 bool Drawable::bindIdx()
 {
     if(idxBound) {
@@ -128,3 +334,76 @@ bool Drawable::bindInf()
     }
     return infBound;
 }
+
+bool Drawable::bindVert()
+{
+    if (vertBound){
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufVert);
+    }
+    return vertBound;
+}
+
+bool Drawable::bindFaceCol()
+{
+    if (faceColBound){
+        mp_context->glActiveTexture(GL_TEXTURE0);
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, texFaceCol);
+    }
+    return faceColBound;
+}
+
+bool Drawable::bindInst()
+{
+    if (instBound){
+        mp_context->glActiveTexture(GL_TEXTURE0 + INSTANCE_TEXTURE_UNIT);
+        mp_context->glBindTexture(GL_TEXTURE_BUFFER, texInst);
+    }
+    return instBound;
+}
+
+const VertexLayout &Drawable::vertexLayout()
+{
+    return layout;
+}
+
+int Drawable::shaderFeatures()
+{
+    bool skinned = jntBound && infBound;
+    bool lit = norBound;
+    if (vertBound){
+        for (const VertexAttribute &a : layout.attributes){
+            skinned = skinned || a.input == VertexAttribute::JNT;
+            lit = lit || a.input == VertexAttribute::NOR;
+        }
+    }
+    return (skinned ? SKINNED : 0) | (lit ? LAMBERT : 0) | (faceColBound ? FACE_COLOURS : 0)
+         | (instBound ? INSTANCED : 0);
+}
+
+GLuint Drawable::vao(GLuint prog)
+{
+    for (const std::pair<GLuint, GLuint> &v : vaos){
+        if (v.first == prog){
+            return v.second;
+        }
+    }
+    return 0;
+}
+
+GLuint Drawable::generateVao(GLuint prog)
+{
+    GLuint v;
+    mp_context->glGenVertexArrays(1, &v);
+    vaos.push_back(std::make_pair(prog, v));
+    return v;
+}
+
+// The VAOs hold the names of the buffers they read from, so they have to be
+// rebuilt once those buffers are deleted or replaced
+void Drawable::dropVaos()
+{
+    for (std::pair<GLuint, GLuint> &v : vaos){
+        mp_context->glDeleteVertexArrays(1, &v.second);
+    }
+    vaos.clear();
+}
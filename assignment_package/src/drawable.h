@@ -1,7 +1,29 @@
 #pragma once
 
 #include <openglcontext.h>
+#include <streambuffer.h>
 #include <la.h>
+#include <vector>
+#include <utility>
+
+// Describes one attribute stored in an interleaved vertex buffer
+struct VertexAttribute {
+    enum Input { POS, NOR, COL, JNT, INF }; // the shader input (vs_Pos, vs_Nor, ...) it feeds
+
+    Input input;
+    GLint size;            // number of components
+    GLenum type;
+    GLboolean normalized;  // maps integer types to [0, 1] or [-1, 1]
+    bool integer;          // read as an integer (ivec) input through glVertexAttribIPointer
+    int offset;            // byte offset from the start of a vertex
+};
+
+// The attributes of every vertex in an interleaved buffer and the number of
+// bytes from one vertex to the next
+struct VertexLayout {
+    std::vector<VertexAttribute> attributes;
+    int stride = 0;
+};
 
 //This defines a class which can be rendered by our shader program.
 //Make any geometry a subclass of ShaderProgram::Drawable in order to render it with the ShaderProgram class.
@@ -15,7 +37,12 @@ protected:
     GLuint bufCol; // Can be used to pass per-vertex color information to the shader, but is currently unused.
     GLuint bufJnt;
     GLuint bufInf;
+    GLuint bufVert; // A single interleaved VBO, described by layout, used in place of bufPos to bufInf
                    // Instead, we use a uniform vec4 in the shader to set an overall color for the geometry
+    GLuint bufFaceCol; // RGBA8 colour of every triangle, read by the shaders through texFaceCol at gl_PrimitiveID
+    GLuint texFaceCol; // A buffer texture over bufFaceCol
+    GLuint bufInst; // Per-instance data of instanced Drawables, read by the shaders through texInst at gl_InstanceID
+    GLuint texInst; // A buffer texture over bufInst
 
     bool idxBound; // Set to TRUE by generateIdx(), returned by bindIdx().
     bool posBound;
@@ -23,6 +50,40 @@ protected:
     bool colBound;
     bool jntBound;
     bool infBound;
+    bool vertBound;
+    bool faceColBound;
+    bool instBound;
+    bool vertShared; // bufVert belongs to another Drawable (see shareVert()), so destroy() leaves it alone
+    bool geometryShared; // so do bufIdx and the face colours (see shareGeometry())
+    bool vertStreamed; // bufVert is vertStream's buffer (see streamVert())
+    bool instStreamed; // bufInst is instStream's
+
+    // The rings streamed vertices and instance data are written into, and
+    // where in them the last writes went: in vertices for vertBase, and in
+    // texels for instBase
+    StreamBuffer vertStream;
+    StreamBuffer instStream;
+    int vertBase;
+    int instBase;
+
+    int instances; // The number of instances drawn, or 0 for a plain draw
+
+    // The parts of bufIdx drawn while ranged is set (see drawRanges()): the
+    // first triangle, index count and byte offset of each
+    bool ranged;
+    std::vector<GLint> rangeFirst;
+    std::vector<GLsizei> rangeIndices;
+    std::vector<const GLvoid*> rangeOffsets;
+
+    VertexLayout layout; // The contents of bufVert
+
+    // Vertex array objects recording how the buffers above feed each shader
+    // program, as (program, VAO) pairs. ShaderProgram::draw sets one up the
+    // first time it draws this Drawable, and they're dropped whenever the
+    // buffers are destroyed or regenerated.
+    std::vector<std::pair<GLuint, GLuint>> vaos;
+
+    void dropVaos();
 
     OpenGLContext* mp_context; // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                           // we need to pass our OpenGL context to the Drawable in order to call GL functions
@@ -30,6 +91,19 @@ protected:
 
 
 public:
+    // The optional parts of the mesh shaders, each compiled in with a #define
+    // of the same name (see ShaderVariants). Combined as bit flags.
+    enum ShaderFeature {
+        SKINNED = 1,      // blends the joint transforms picked by vs_Jnt by vs_Inf
+        DUAL_QUAT = 2,    // reads the skin palette as dual quaternions, SKINNED only
+        LAMBERT = 4,      // diffuse lighting from the camera, which needs vs_Nor
+        FACE_COLOURS = 8, // colours triangles from texFaceCol instead of vs_Col
+        INSTANCED = 16    // draws instances() copies, each moved and tinted by its texels in texInst
+    };
+
+    // The texture unit bindInst() binds texInst to
+    static const int INSTANCE_TEXTURE_UNIT = 2;
+
     Drawable(OpenGLContext* context);
     virtual ~Drawable();
 
@@ -39,6 +113,18 @@ public:
     // Getter functions for various GL data
     virtual GLenum drawMode();
     int elemCount();
+    int instanceCount();
+
+    // Limits the draws to the given (first triangle, triangle count) ranges
+    // of the index buffer, which ShaderProgram::draw covers with one
+    // glMultiDrawElements. drawAll() goes back to drawing everything.
+    void drawRanges(const std::vector<std::pair<int, int>> &ranges);
+    void drawAll();
+    // The ranges to draw, or -1 if everything is drawn
+    int rangeCount();
+    int rangeTriangle(int i);
+    const GLsizei *rangeCounts();
+    const GLvoid *const *rangeStarts();
 
     // Call these functions when you want to call glGenBuffers on the buffers stored in the Drawable
     // These will properly set the values of idxBound etc. which need to be checked in ShaderProgram::draw()
@@ -48,6 +134,37 @@ public:
     void generateCol();
     void generateJnt();
     void generateInf();
+    void generateVert();
+    void generateFaceCol(); // Creates both bufFaceCol and texFaceCol
+    void generateInst(); // Creates both bufInst and texInst
+
+    // Reads vertices from other's bufVert instead of a buffer of its own, for
+    // overlays drawn from the same vertices with different indices. other's
+    // buffer has to outlive this Drawable's, or be shared again once it's
+    // recreated.
+    void shareVert(Drawable &other);
+
+    // Shares all of other's geometry: its vertices, indices and face
+    // colours, so that only the instance data is this Drawable's own. Copies
+    // of a mesh then cost their instance texels and nothing else.
+    void shareGeometry(Drawable &other);
+
+    // For vertices or instance data the CPU writes again whenever they
+    // change, which may be every frame. streamVert() returns where to write
+    // vertexCount vertices of layout l, in the next region of a StreamBuffer
+    // that then stands in for bufVert, and unmapVert() ends the writes;
+    // ShaderProgram::draw reads that region through baseVertex() and fences
+    // it. streamInst() and unmapInst() are the same for RGBA32F texels of
+    // bufInst, read from instanceBase() on. Ranged draws (see drawRanges())
+    // don't take the base into account, so they can't be streamed.
+    void *streamVert(const VertexLayout &l, int vertexCount);
+    void unmapVert();
+    void *streamInst(int texels);
+    void unmapInst();
+    int baseVertex();
+    int instanceBase();
+    // Fences the streamed regions, once the draws reading them are issued
+    void fenceStreams();
 
     bool bindIdx();
     bool bindPos();
@@ -55,4 +172,19 @@ public:
     bool bindCol();
     bool bindJnt();
     bool bindInf();
+    bool bindVert();
+    bool bindFaceCol(); // Binds texFaceCol to texture unit 0
+    bool bindInst(); // Binds texInst to INSTANCE_TEXTURE_UNIT
+
+    const VertexLayout &vertexLayout();
+
+    // The shader features this Drawable's buffers can feed: SKINNED if it has
+    // joints and influences, LAMBERT if it has normals, FACE_COLOURS if it
+    // has per-triangle colours and INSTANCED if it has per-instance data
+    virtual int shaderFeatures();
+
+    // Returns the VAO set up for the given program, or 0 if there is none yet
+    GLuint vao(GLuint prog);
+    // Creates an empty VAO for the given program. The caller binds it and sets up the attributes.
+    GLuint generateVao(GLuint prog);
 };
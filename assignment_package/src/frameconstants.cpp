@@ -0,0 +1,38 @@
+#include "frameconstants.h"
+#include <cstring>
+
+FrameConstants::FrameConstants(OpenGLContext *context)
+    : context(context), buf(), generated(false), uploaded()
+{}
+
+bool FrameConstants::update(const glm::mat4 &viewProj, const glm::vec3 &camPos)
+{
+    Block block;
+    block.viewProj = viewProj;
+    block.camPos = glm::vec4(camPos, 1.f);
+
+    if (generated && std::memcmp(&block, &uploaded, sizeof(Block)) == 0){
+        return false;
+    }
+    uploaded = block;
+
+    if (!generated){
+        context->glGenBuffers(1, &buf);
+        context->glBindBuffer(GL_UNIFORM_BUFFER, buf);
+        context->glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &uploaded, GL_DYNAMIC_DRAW);
+        context->glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buf);
+        generated = true;
+    } else {
+        context->glBindBuffer(GL_UNIFORM_BUFFER, buf);
+        context->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &uploaded);
+    }
+    return true;
+}
+
+void FrameConstants::destroy()
+{
+    if (generated){
+        context->glDeleteBuffers(1, &buf);
+    }
+    generated = false;
+}
@@ -0,0 +1,38 @@
+#ifndef FRAMECONSTANTS_H
+#define FRAMECONSTANTS_H
+
+#include <openglcontext.h>
+#include <la.h>
+
+// The uniforms every shader program shares for a frame (the camera), kept in
+// one std140 uniform buffer that all programs read through their
+// FrameConstants block. It's bound to BINDING once, and uploaded once per
+// frame at most, only when the camera moved.
+class FrameConstants
+{
+private:
+    // Mirrors the FrameConstants block in the shaders
+    struct Block {
+        glm::mat4 viewProj;
+        glm::vec4 camPos;   // w unused, since std140 pads a vec3 to 16 bytes anyway
+    };
+
+    OpenGLContext *context;
+    GLuint buf;
+    bool generated;
+    Block uploaded;
+
+public:
+    // The uniform buffer binding point the programs' blocks are attached to
+    static const int BINDING = 0;
+
+    FrameConstants(OpenGLContext *context);
+
+    // Uploads the camera if it changed since the last call. Returns whether
+    // an upload happened.
+    bool update(const glm::mat4 &viewProj, const glm::vec3 &camPos);
+
+    void destroy();
+};
+
+#endif // FRAMECONSTANTS_H
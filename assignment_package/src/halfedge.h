@@ -16,6 +16,7 @@ private:
     // iD counter, used to assign sequentially increasing
     // numbers to faces
     static int counter;
+    friend class Mesh; // puts the count back after loading another mesh (see Mesh::loadAsync)
 public:
 
     //Default constructor for half edges
@@ -123,153 +123,33 @@ void Joint::loadJSON(std::string fileName)
     createJoint(root);
 }
 
+// Joints are drawn all at once by JointGizmos and JointLinks, so a Joint
+// has no buffers of its own
 void Joint::create()
-{
-    std::vector<glm::vec4> circleUp;
-    std::vector<glm::vec4> circleRight;
-    std::vector<glm::vec4> circleForward;
-
-    std::vector<glm::vec4> positions;
-    std::vector<glm::vec4> col;
-    std::vector<int> idx;
-
-
-    int numSides = 30;
-    glm::vec4 pR(0.f, 0.f, 0.5f, 1.f);
-    glm::vec4 pU(0.5f, 0.f, 0.f, 1.f);
-    glm::vec4 pF(0.5f, 0.f, 0.f, 1.f);
-
-    float deg = glm::radians(360.f / numSides);
-    for (int i = 0; i < numSides; i++)
-    {
-        glm::mat4 mU = glm::rotate(glm::mat4(), i * deg, glm::vec3(0, 1, 0));
-        glm::mat4 mR = glm::rotate(glm::mat4(), i * deg, glm::vec3(1, 0, 0));
-        glm::mat4 mF = glm::rotate(glm::mat4(), i * deg, glm::vec3(0, 0, 1));
-        circleUp.push_back(mU * pU);
-        circleRight.push_back(mR * pR);
-        circleForward.push_back(mF * pF);
-    }
-
-    for (glm::vec4 &vert : circleUp){
-        vert = getOverallTransformation() * vert;
-        positions.push_back(vert);
-        if (selected){
-            col.push_back(glm::vec4(1, 1, 1, 1));
-        } else {
-            col.push_back(glm::vec4(0, 1, 0, 1));
-        }
-    }
-    for (glm::vec4 &vert : circleRight){
-        vert = getOverallTransformation() * vert;
-        positions.push_back(vert);
-        if (selected){
-            col.push_back(glm::vec4(1, 1, 1, 1));
-        } else {
-            col.push_back(glm::vec4(1, 0, 0, 1));
-        }
-    }
-    for (glm::vec4 &vert : circleForward){
-        vert = getOverallTransformation() * vert;
-        positions.push_back(vert);
-        if (selected){
-            col.push_back(glm::vec4(1, 1, 1, 1));
-        } else {
-            col.push_back(glm::vec4(0, 0, 1, 1));
-        }
-    }
-    for (int i = 0; i < circleUp.size(); i++){
-        idx.push_back(i);
-        idx.push_back((i + 1) % (circleUp.size() - 1));
-    }
-    int loopLengthA = circleUp.size() + circleRight.size();
-    for (int i = circleUp.size(); i < loopLengthA; i++){
-        idx.push_back(i);
-        if (i == loopLengthA - 1){
-            idx.push_back(circleUp.size());
-        } else {
-            idx.push_back((i + 1));
-        }
-    }
-    int loopLengthB = circleForward.size() + loopLengthA;
-    for (int i = loopLengthA; i < loopLengthB; i++){
-        idx.push_back(i);
-        if (i == loopLengthB - 1){
-            idx.push_back(loopLengthA);
-        } else {
-            idx.push_back((i + 1));
-        }
-    }
+{}
 
-    if (parent){
-        int len = positions.size();
-        positions.push_back(getOverallTransformation() * glm::vec4(0, 0.5, 0, 1));
-        positions.push_back(getOverallTransformation() * glm::vec4(0, -0.5, 0, 1));
-        positions.push_back(getOverallTransformation() * glm::vec4(0, 0, 0.5, 1));
-        positions.push_back(getOverallTransformation() * glm::vec4(0, 0, -0.5, 1));
-        positions.push_back(getOverallTransformation() * glm::vec4(0.5, 0, 0, 1));
-        positions.push_back(getOverallTransformation() * glm::vec4(-0.5, 0, 0, 1));
-        positions.push_back(getOverallTransformation() * glm::inverse(glm::toMat4(rotation)) * glm::vec4(-pos, 1));
-        glm::vec4 color;
-        if (selected){
-            color = glm::vec4(1, 1, 1, 1);
-        } else {
-            color = glm::vec4(1, 1, 0, 1);
-        }
-        col.push_back(color);
-        col.push_back(color);
-        col.push_back(color);
-        col.push_back(color);
-        col.push_back(color);
-        col.push_back(color);
-        if (selected){
-            col.push_back(glm::vec4(1, 1, 1, 1));
-        } else {
-            col.push_back(glm::vec4(1, 0, 1, 1));
-        }
-        idx.push_back(len);
-        idx.push_back(len + 6);
-        idx.push_back(len + 1);
-        idx.push_back(len + 6);
-        idx.push_back(len + 2);
-        idx.push_back(len + 6);
-        idx.push_back(len + 3);
-        idx.push_back(len + 6);
-        idx.push_back(len + 4);
-        idx.push_back(len + 6);
-        idx.push_back(len + 5);
-        idx.push_back(len + 6);
 
-    }
-
-    count = idx.size();
-
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
-
-    generatePos();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec4), positions.data(), GL_STATIC_DRAW);
-
-    generateCol();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, col.size() * sizeof(glm::vec4), col.data(), GL_STATIC_DRAW);
-
-    for (uPtr<Joint> &child : children){
-        child.get()->create();
+void retrieveJoints (Joint *j, std::vector<Joint *> &acc)
+{
+    acc.push_back(j);
+    for (uPtr<Joint> &child : j->children){
+        retrieveJoints(child.get(), acc);
     }
 }
 
-
-void retrieveJoints (Joint *j, std::vector<Joint *> &acc)
+static void retrieveJoints (Joint *j, const glm::mat4 &parentOverall,
+                            std::vector<Joint *> &acc, std::vector<glm::mat4> &overall)
 {
     acc.push_back(j);
+    overall.push_back(parentOverall * j->getLocalTransformation());
+    glm::mat4 own = overall.back();
     for (uPtr<Joint> &child : j->children){
-        retrieveJoints(child.get(), acc);
+        retrieveJoints(child.get(), own, acc, overall);
     }
 }
 
-GLenum Joint::drawMode()
+void retrieveJoints (Joint *j, std::vector<Joint *> &acc, std::vector<glm::mat4> &overall)
 {
-    return GL_LINES;
+    glm::mat4 parentOverall = j->parent ? j->parent->getOverallTransformation() : glm::mat4(1.f);
+    retrieveJoints(j, parentOverall, acc, overall);
 }
@@ -7,8 +7,9 @@
 #include <drawable.h>
 #include <smartpointerhelp.h>
 
-// inherits both Drawable (to be able to be rendered),
-// and QTreeWidgeItem (for display in the GUI)
+// inherits both Drawable (so it can be the selected item in MyGL, though
+// the joints are drawn by JointGizmos and JointLinks), and QTreeWidgeItem
+// (for display in the GUI)
 class Joint : public Drawable, public QTreeWidgetItem
 {
 private:
@@ -42,7 +43,6 @@ public:
     glm::mat4 bind;
 
     void create() override;
-    GLenum drawMode() override;
 
     // Adds a child while setting its position to the given
     // paramenter and parent pointer to this
@@ -66,4 +66,9 @@ public:
 // Retrieves all the children of a joint and places pointers to them in a std::vector<Joint*>
 void retrieveJoints (Joint *j, std::vector<Joint *> &acc);
 
+// Same as above, also placing the overall transformation of every joint in
+// overall. Each one is built from its parent's, instead of walking up to the
+// root for every joint.
+void retrieveJoints (Joint *j, std::vector<Joint *> &acc, std::vector<glm::mat4> &overall);
+
 #endif // JOINT_H
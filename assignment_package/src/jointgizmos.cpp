@@ -0,0 +1,179 @@
+#include "jointgizmos.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstring>
+
+// Segments in each of the circles around a joint
+static const int CIRCLE_SIDES = 30;
+
+JointGizmos::JointGizmos(OpenGLContext *context)
+    : Drawable(context), uploaded(), staged()
+{}
+
+void JointGizmos::create()
+{
+    std::vector<glm::vec4> positions;
+    std::vector<glm::vec4> col;
+    std::vector<GLuint> idx;
+
+    // A circle of radius 0.5 around each axis: green around y, red around x
+    // and blue around z
+    struct Circle {
+        glm::vec3 axis;
+        glm::vec4 start;
+        glm::vec4 colour;
+    };
+    const Circle circles[] = {
+        {glm::vec3(0, 1, 0), glm::vec4(0.5f, 0.f, 0.f, 1.f), glm::vec4(0, 1, 0, 1)},
+        {glm::vec3(1, 0, 0), glm::vec4(0.f, 0.f, 0.5f, 1.f), glm::vec4(1, 0, 0, 1)},
+        {glm::vec3(0, 0, 1), glm::vec4(0.5f, 0.f, 0.f, 1.f), glm::vec4(0, 0, 1, 1)}
+    };
+
+    float deg = glm::radians(360.f / CIRCLE_SIDES);
+    for (const Circle &c : circles){
+        GLuint first = positions.size();
+        for (int i = 0; i < CIRCLE_SIDES; i++){
+            positions.push_back(glm::rotate(glm::mat4(), i * deg, c.axis) * c.start);
+            col.push_back(c.colour);
+            idx.push_back(first + i);
+            idx.push_back(first + (i + 1) % CIRCLE_SIDES);
+        }
+    }
+
+    count = idx.size();
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+
+    generatePos();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec4), positions.data(), GL_STATIC_DRAW);
+
+    generateCol();
+    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
+    mp_context->glBufferData(GL_ARRAY_BUFFER, col.size() * sizeof(glm::vec4), col.data(), GL_STATIC_DRAW);
+}
+
+GLenum JointGizmos::drawMode()
+{
+    return GL_LINES;
+}
+
+bool JointGizmos::update(const std::vector<Joint*> &joints, const std::vector<glm::mat4> &overall)
+{
+    staged.resize(5 * joints.size());
+    for (size_t i = 0; i < joints.size(); i++){
+        for (int c = 0; c < 4; c++){
+            staged[5 * i + c] = overall[i][c];
+        }
+        // The alpha is how far the circles' own colours are pulled towards the tint
+        staged[5 * i + 4] = joints[i]->selected ? glm::vec4(1.f) : glm::vec4(0.f);
+    }
+    instances = joints.size();
+
+    // destroy() drops the instance buffer along with the circles
+    if (!instBound){
+        uploaded.clear();
+    }
+
+    if (instBound && staged.size() == uploaded.size() &&
+        std::memcmp(staged.data(), uploaded.data(), staged.size() * sizeof(glm::vec4)) == 0){
+        return false;
+    }
+    uploaded.swap(staged);
+
+    // Dragging a joint changes every frame, so the texels are streamed
+    // rather than written over the ones the last frame may still be drawing
+    void *memory = streamInst(uploaded.size());
+    std::memcpy(memory, uploaded.data(), uploaded.size() * sizeof(glm::vec4));
+    unmapInst();
+    return true;
+}
+
+JointLinks::JointLinks(OpenGLContext *context)
+    : Drawable(context), pos(), col()
+{
+    // The position and colour of every vertex, interleaved in the stream
+    layout.attributes = {
+        {VertexAttribute::POS, 4, GL_FLOAT, GL_FALSE, false, 0},
+        {VertexAttribute::COL, 4, GL_FLOAT, GL_FALSE, false, int(sizeof(glm::vec4))}
+    };
+    layout.stride = 2 * sizeof(glm::vec4);
+}
+
+void JointLinks::create()
+{
+    // Every link is six lines from the tips of the joint's axes to its parent
+    std::vector<GLuint> idx;
+    for (GLuint first = 0; first < pos.size(); first += 7){
+        for (GLuint tip = 0; tip < 6; tip++){
+            idx.push_back(first + tip);
+            idx.push_back(first + 6);
+        }
+    }
+
+    count = idx.size();
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+
+    stream();
+}
+
+void JointLinks::stream()
+{
+    glm::vec4 *v = static_cast<glm::vec4*>(streamVert(layout, pos.size()));
+    for (size_t i = 0; i < pos.size(); i++){
+        v[2 * i] = pos[i];
+        v[2 * i + 1] = col[i];
+    }
+    unmapVert();
+}
+
+GLenum JointLinks::drawMode()
+{
+    return GL_LINES;
+}
+
+bool JointLinks::update(const std::vector<Joint*> &joints, const std::vector<glm::mat4> &overall)
+{
+    static const glm::vec4 tips[] = {
+        glm::vec4(0, 0.5, 0, 1), glm::vec4(0, -0.5, 0, 1),
+        glm::vec4(0, 0, 0.5, 1), glm::vec4(0, 0, -0.5, 1),
+        glm::vec4(0.5, 0, 0, 1), glm::vec4(-0.5, 0, 0, 1)
+    };
+
+    std::vector<glm::vec4> newPos;
+    std::vector<glm::vec4> newCol;
+    for (size_t i = 0; i < joints.size(); i++){
+        Joint *j = joints[i];
+        if (!j->parent){
+            continue;
+        }
+        glm::vec4 tipColour = j->selected ? glm::vec4(1, 1, 1, 1) : glm::vec4(1, 1, 0, 1);
+        for (const glm::vec4 &tip : tips){
+            newPos.push_back(overall[i] * tip);
+            newCol.push_back(tipColour);
+        }
+        // The parent's origin, seen from this joint
+        newPos.push_back(overall[i] * glm::inverse(glm::toMat4(j->rotation)) * glm::vec4(-j->pos, 1));
+        newCol.push_back(j->selected ? glm::vec4(1, 1, 1, 1) : glm::vec4(1, 0, 1, 1));
+    }
+
+    if (idxBound && newPos == pos && newCol == col){
+        return false;
+    }
+    // Only a joint gaining or losing its parent changes the indices; moving
+    // one just streams the vertices again
+    bool sameLinks = idxBound && newPos.size() == pos.size();
+    pos.swap(newPos);
+    col.swap(newCol);
+    if (sameLinks){
+        stream();
+    } else {
+        destroy();
+        create();
+    }
+    return true;
+}
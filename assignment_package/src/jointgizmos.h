@@ -0,0 +1,59 @@
+#ifndef JOINTGIZMOS_H
+#define JOINTGIZMOS_H
+
+#include <drawable.h>
+#include <joint.h>
+#include <vector>
+
+// The three circles drawn around every joint of a skeleton. The circles are
+// stored once and drawn as an instance per joint, which reads the joint's
+// overall transformation and tint from texInst, so the whole skeleton takes
+// one draw call however many joints it has.
+class JointGizmos : public Drawable
+{
+private:
+    // Five texels per joint, laid out as mesh.vert.glsl's u_Instances
+    // expects. staged is filled on every update() and only swapped in (and
+    // streamed) if it differs from uploaded.
+    std::vector<glm::vec4> uploaded;
+    std::vector<glm::vec4> staged;
+
+public:
+    JointGizmos(OpenGLContext *context);
+
+    // Creates the circles every instance shares
+    void create() override;
+    GLenum drawMode() override;
+
+    // Places an instance at each of joints, given their overall
+    // transformations (see retrieveJoints). Selected joints are tinted white.
+    // Returns whether anything had to be uploaded.
+    bool update(const std::vector<Joint*> &joints, const std::vector<glm::mat4> &overall);
+};
+
+// The lines from every joint to its parent, kept in one GL_LINES batch for
+// the whole skeleton. The vertices are streamed (see Drawable::streamVert),
+// as they change on every frame a joint is dragged.
+class JointLinks : public Drawable
+{
+private:
+    // The batch last uploaded
+    std::vector<glm::vec4> pos;
+    std::vector<glm::vec4> col;
+
+    // Writes pos and col, interleaved, into the next region of the stream
+    void stream();
+
+public:
+    JointLinks(OpenGLContext *context);
+
+    // Builds the indices for the links in pos and streams pos and col
+    void create() override;
+    GLenum drawMode() override;
+
+    // Rebuilds the batch from joints and their overall transformations (see
+    // retrieveJoints), and uploads it if it changed. Returns whether it did.
+    bool update(const std::vector<Joint*> &joints, const std::vector<glm::mat4> &overall);
+};
+
+#endif // JOINTGIZMOS_H
@@ -1,4 +1,5 @@
 #include <mainwindow.h>
+#include <openglcontext.h>
 
 #include <QApplication>
 #include <QSurfaceFormat>
@@ -24,12 +25,16 @@ int main(int argc, char *argv[])
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QApplication a(argc, argv);
 
-    // Set OpenGL 3.2 and, optionally, 4-sample multisampling
+    // Set OpenGL 3.2. The widget's own framebuffer isn't multisampled, since
+    // MyGL antialiases into a framebuffer of its own (see AntiAliasing).
     QSurfaceFormat format;
     format.setVersion(3, 2);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     format.setProfile(QSurfaceFormat::CoreProfile);
-    //format.setSamples(4);  // Uncomment for nice antialiasing. Not always supported.
+    // Drivers only have to report through KHR_debug in a debug context
+    if (OpenGLContext::DEBUG_OUTPUT_DEFAULT) {
+        format.setOption(QSurfaceFormat::DebugContext);
+    }
 
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
     /*** Check whether automatic testing is enabled */
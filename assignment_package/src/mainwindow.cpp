@@ -8,6 +8,7 @@
 #include <joint.h>
 #include <iostream>
 #include <QFileDialog>
+#include <QActionGroup>
 #include <fstream>
 
 
@@ -17,6 +18,16 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
     ui->mygl->setFocus();
+    ui->actionGL_Debug_Output->setChecked(OpenGLContext::DEBUG_OUTPUT_DEFAULT);
+
+    // Only one antialiasing mode can be checked at a time
+    QActionGroup *antiAliasing = new QActionGroup(this);
+    antiAliasing->addAction(ui->actionAA_None);
+    antiAliasing->addAction(ui->actionAA_MSAA);
+    antiAliasing->addAction(ui->actionAA_FXAA);
+    ui->actionAA_None->setChecked(ui->mygl->antiAliasing() == AntiAliasing::NONE);
+    ui->actionAA_MSAA->setChecked(ui->mygl->antiAliasing() == AntiAliasing::MSAA);
+    ui->actionAA_FXAA->setChecked(ui->mygl->antiAliasing() == AntiAliasing::FXAA);
 
     connect(ui->mygl, SIGNAL(ctxInitialized()), this, SLOT(loadListWidget()));
     connect(ui->vertsListWidget, SIGNAL(itemClicked(QListWidgetItem*)), this, SLOT(selectVertex(QListWidgetItem*)));
@@ -90,6 +101,20 @@ void MainWindow::on_actionLoad_Skeleton_triggered()
     ui->skeleton->blockSignals(false);
 }
 
+// Lays out copies of an obj file behind the mesh, which share its geometry
+void MainWindow::on_actionLoad_OBJ_Herd_triggered()
+{
+    QString fileName = QFileDialog::getOpenFileName(0, QString("Load OBJ Herd"), QDir::currentPath().append(QString("../..")), QString("*.obj"));
+    if (fileName.isEmpty()){
+        return;
+    }
+    ui->mygl->loadHerd(fileName.toStdString(), 6, 6);
+}
+
+void MainWindow::on_actionClear_Herds_triggered()
+{
+    ui->mygl->clearHerds();
+}
 
 void MainWindow::on_actionCamera_Controls_triggered()
 {
@@ -98,6 +123,116 @@ void MainWindow::on_actionCamera_Controls_triggered()
 }
 
 
+void MainWindow::on_actionAdaptive_Subdivision_triggered()
+{
+    ui->mygl->adaptiveMode = ui->actionAdaptive_Subdivision->isChecked();
+    ui->mygl->redraw();
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionDistance_LOD_triggered()
+{
+    ui->mygl->lodMode = ui->actionDistance_LOD->isChecked();
+    ui->mygl->redraw();
+    ui->mygl->setFocus();
+}
+
+// Builds the LODs and switches to them right away
+void MainWindow::on_actionBuild_LODs_triggered()
+{
+    ui->mygl->buildLODs();
+    ui->actionDistance_LOD->setChecked(true);
+    on_actionDistance_LOD_triggered();
+}
+
+void MainWindow::on_actionVertex_Cache_Report_triggered()
+{
+    ui->mygl->reportVertexCache();
+}
+
+void MainWindow::on_actionShared_Vertices_triggered()
+{
+    ui->mygl->setSharedVertices(ui->actionShared_Vertices->isChecked());
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionShow_All_Vertices_triggered()
+{
+    ui->mygl->setVertexOverlay(ui->actionShow_All_Vertices->isChecked());
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionShow_Wireframe_triggered()
+{
+    ui->mygl->setWireframeOverlay(ui->actionShow_Wireframe->isChecked());
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionDual_Quaternion_Skinning_triggered()
+{
+    ui->mygl->setDualQuatSkinning(ui->actionDual_Quaternion_Skinning->isChecked());
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionGL_Debug_Output_triggered()
+{
+    ui->mygl->setDebugOutput(ui->actionGL_Debug_Output->isChecked());
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionAA_None_triggered()
+{
+    ui->mygl->setAntiAliasing(AntiAliasing::NONE);
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionAA_MSAA_triggered()
+{
+    ui->mygl->setAntiAliasing(AntiAliasing::MSAA);
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionAA_FXAA_triggered()
+{
+    ui->mygl->setAntiAliasing(AntiAliasing::FXAA);
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionTriangulate_All_triggered()
+{
+    ui->mygl->triangulateAll();
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionSplit_All_Edges_triggered()
+{
+    ui->mygl->splitAllEdges();
+    ui->mygl->setFocus();
+}
+
+// Splits every half edge selected in the list (ctrl/shift-click to pick several)
+void MainWindow::on_actionSplit_Selected_Edges_triggered()
+{
+    std::vector<HalfEdge*> edges;
+    for (QListWidgetItem *item : ui->halfEdgesListWidget->selectedItems()){
+        edges.push_back(dynamic_cast<HalfEdge*>(item));
+    }
+    ui->mygl->splitEdges(edges);
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionSmooth_Uniform_triggered()
+{
+    ui->mygl->smoothMesh(LaplacianSmoother::UNIFORM, 10);
+    ui->mygl->setFocus();
+}
+
+void MainWindow::on_actionSmooth_Cotangent_triggered()
+{
+    ui->mygl->smoothMesh(LaplacianSmoother::COTANGENT, 10);
+    ui->mygl->setFocus();
+}
+
 void MainWindow::loadListWidget()
 {
     std::vector<Face*> faces;
@@ -215,8 +350,12 @@ void MainWindow::selectHalfEdge(QListWidgetItem *selected)
     ui->vertJntInf0->blockSignals(true);
     ui->vertJntInf1->blockSignals(true);
 
+    // Clicked items are already current; setting them again would drop the
+    // rest of a multiple selection
     ui->halfEdgesListWidget->blockSignals(true);
-    ui->halfEdgesListWidget->setCurrentItem(selected);
+    if (ui->halfEdgesListWidget->currentItem() != selected){
+        ui->halfEdgesListWidget->setCurrentItem(selected);
+    }
     ui->halfEdgesListWidget->blockSignals(false);
 
     // enabling and disabling appropriate spinboxes
@@ -357,21 +496,21 @@ void MainWindow::setFaceRed(double r)
 {
     Face *f = dynamic_cast<Face*>(ui->facesListWidget->currentItem());
     f->colour[0] = r;
-    ui->mygl->refreshMesh();
+    ui->mygl->refreshFace(f);
 }
 
 void MainWindow::setFaceGreen(double g)
 {
     Face *f = dynamic_cast<Face*>(ui->facesListWidget->currentItem());
     f->colour[1] = g;
-    ui->mygl->refreshMesh();
+    ui->mygl->refreshFace(f);
 }
 
 void MainWindow::setFaceBlue(double b)
 {
     Face *f = dynamic_cast<Face*>(ui->facesListWidget->currentItem());
     f->colour[2] = b;
-    ui->mygl->refreshMesh();
+    ui->mygl->refreshFace(f);
 }
 
 void MainWindow::addVertex()
@@ -436,7 +575,7 @@ void MainWindow::selectJoint(QTreeWidgetItem *current)
         ui->vertPosYSpinBox->setValue(curr->pos[1]);
         ui->vertPosZSpinBox->setValue(curr->pos[2]);
     }
-    ui->mygl->refreshMesh();
+    ui->mygl->refreshSelection();
 
     ui->vertPosXSpinBox->blockSignals(false);
     ui->vertPosYSpinBox->blockSignals(false);
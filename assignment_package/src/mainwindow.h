@@ -26,8 +26,33 @@ private slots:
 
     void on_actionLoad_Skeleton_triggered();
 
+    void on_actionLoad_OBJ_Herd_triggered();
+    void on_actionClear_Herds_triggered();
+
     void on_actionCamera_Controls_triggered();
 
+    // Toggles view-dependent adaptive subdivision of the mesh
+    void on_actionAdaptive_Subdivision_triggered();
+    void on_actionDistance_LOD_triggered();
+    void on_actionBuild_LODs_triggered();
+    void on_actionVertex_Cache_Report_triggered();
+    // Switches m_mesh between shared vertices and one vertex per face corner
+    void on_actionShared_Vertices_triggered();
+    void on_actionShow_All_Vertices_triggered();
+    void on_actionShow_Wireframe_triggered();
+    void on_actionDual_Quaternion_Skinning_triggered();
+    void on_actionGL_Debug_Output_triggered();
+    void on_actionAA_None_triggered();
+    void on_actionAA_MSAA_triggered();
+    void on_actionAA_FXAA_triggered();
+
+    // Whole-mesh versions of triangulate() and addVertex()
+    void on_actionTriangulate_All_triggered();
+    void on_actionSplit_All_Edges_triggered();
+    void on_actionSplit_Selected_Edges_triggered();
+    void on_actionSmooth_Uniform_triggered();
+    void on_actionSmooth_Cotangent_triggered();
+
     // loads all the mesh data into the QListWidgets
     void loadListWidget();
 
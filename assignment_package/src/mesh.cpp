@@ -2,9 +2,11 @@
 #include <iostream>
 #include <smartpointerhelp.h>
 #include <unordered_map>
+#include <array>
+#include <algorithm>
 
 Mesh::Mesh(OpenGLContext *context)
-    : Drawable(context)
+    : Drawable(context), sharedVertices(true), skinned(false)
 {}
 
 HalfEdge *Mesh::edgePtr(int index)
@@ -22,102 +24,227 @@ Face *Mesh::facePtr(int index)
     return faces[index].get();
 }
 
+int Mesh::uniformArity()
+{
+    int arity = -1;
+    for (uPtr<Face> &f : faces){
+        HalfEdge *first = f->edge;
+        int n = 1;
+        for (HalfEdge *e = first->next; e != first && n <= 4; e = e->next){
+            n++;
+        }
+        if (n > 4 || (arity != -1 && n != arity)){
+            return 0;
+        }
+        arity = n;
+    }
+    return arity == 3 || arity == 4 ? arity : 0;
+}
+
 void Mesh::create()
 {
+    prepare(buffers, clusters, mp_context->supportsPackedNormals());
+    MeshBufferSet set;
+    uploadBuffers(*mp_context, buffers, set);
+    adopt(set);
+}
 
-    // The VBOs for position, normals, colour, and index, respectively
-    std::vector <glm::vec4> pos;
-    std::vector <glm::vec4> nor;
-    std::vector <glm::vec4> col;
-    std::vector <GLuint> idx;
-    std::vector <int> jnt;
-    std::vector <float> inf;
-    bool vertsBound = false;
-
-
-    // We loop through the faces in order to set the normals and colours per face
-    // and in order to triangulate the indices per face.
-    for (std::unique_ptr<Face> &f : faces){
-
-        // The vector of vertices in a given face
-        std::vector<Vertex> faceVerts;
-
-        // the size of the position vector, used as an index offset for triangulation
-        int vertIdx = pos.size();
-
-        // used to loop through the face; when firstEdge == currentEdge, we know that
-        // we've completed a loop around the face
-        HalfEdge *firstEdge = f.get()->edge;
-        HalfEdge *currentEdge = firstEdge;
-
-        // This variable stores the normal for every vertex we go through
-        glm::vec3 normal;
-        do{
-            Vertex &v = *currentEdge->vert;
-            faceVerts.push_back(v);
-            pos.push_back(glm::vec4(v.pos[0], v.pos[1], v.pos[2], 1));
-
-            if (v.bound){
-                vertsBound = true;
-                jnt.push_back(v.skin[0]->iD);
-                jnt.push_back(v.skin[1]->iD);
-
-                inf.push_back(v.influence[0]);
-                inf.push_back(v.influence[1]);
-            }
-            // a colour element is pushed back for every position since there must be a
-            // 1:1 relationship between them
-            col.push_back(glm::vec4(f.get()->colour, 1.f));
-            currentEdge = (currentEdge->next);
-        } while (currentEdge != firstEdge);
-        normal = -glm::normalize(glm::cross(faceVerts[0].pos - faceVerts[1].pos,
-                                           faceVerts[0].pos - faceVerts[faceVerts.size() - 1].pos));
-        nor.push_back(glm::vec4(normal, 0));
-        for (int i = 1; i < faceVerts.size() - 1; i++){
-            normal = -glm::normalize(glm::cross(faceVerts[i].pos - faceVerts[i + 1 % faceVerts.size()].pos,
-                                               faceVerts[i].pos - faceVerts[i - 1 % faceVerts.size()].pos));
-            nor.push_back(glm::vec4(normal, 0));
-
-            // The triangulation part
-            idx.push_back(vertIdx);
-            idx.push_back(vertIdx + i);
-            idx.push_back(vertIdx + i + 1);
-        }
+void Mesh::prepare(MeshBufferBuilder &b, MeshClusters &c, bool packedNormals)
+{
+    // The faces are laid out cluster by cluster, so every cluster is one
+    // range of the index buffer
+    c.sort(faces);
+
+    // and with shared vertices, in an order that keeps reusing the vertices
+    // still in the GPU's vertex cache inside each cluster, so fewer of them
+    // go through the vertex shader (and skinning) more than once
+    if (sharedVertices){
+        c.reorder(faces);
+    }
+    b.build(faces, vertices,
+            sharedVertices ? MeshBufferBuilder::SHARED_VERTICES : MeshBufferBuilder::FACE_CORNERS,
+            packedNormals, skinned, c.order);
+    c.split(b, faces);
+}
+
+void Mesh::uploadBuffers(QOpenGLFunctions_3_2_Core &gl, const MeshBufferBuilder &b, MeshBufferSet &set)
+{
+    gl.glGenBuffers(1, &set.idx);
+    gl.glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, set.idx);
+    gl.glBufferData(GL_ELEMENT_ARRAY_BUFFER, b.idx.size() * sizeof(GLuint), b.idx.data(), GL_STATIC_DRAW);
+
+    // Positions (with normals and colours for face corners) and skinning data
+    // all go into one interleaved buffer, described by layout
+    gl.glGenBuffers(1, &set.vert);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, set.vert);
+    gl.glBufferData(GL_ARRAY_BUFFER, b.verts.size(), b.verts.data(), GL_STATIC_DRAW);
+
+    if (b.mode == MeshBufferBuilder::SHARED_VERTICES){
+        gl.glGenBuffers(1, &set.faceCol);
+        gl.glBindBuffer(GL_TEXTURE_BUFFER, set.faceCol);
+        gl.glBufferData(GL_TEXTURE_BUFFER, b.faceCols.size() * sizeof(GLuint), b.faceCols.data(), GL_STATIC_DRAW);
+        gl.glGenTextures(1, &set.texFaceCol);
+        gl.glBindTexture(GL_TEXTURE_BUFFER, set.texFaceCol);
+        gl.glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, set.faceCol);
+    }
+}
+
+void Mesh::adopt(const MeshBufferSet &set)
+{
+    destroy();
+    layout = buffers.layout;
+    count = buffers.idx.size();
+
+    idxBound = vertBound = true;
+    bufIdx = set.idx;
+    bufVert = set.vert;
+    if (set.faceCol){
+        faceColBound = true;
+        bufFaceCol = set.faceCol;
+        texFaceCol = set.texFaceCol;
+    }
+}
+
+void Mesh::createAsync(BufferUploader &uploader)
+{
+    // Only the upload is left to the thread: the faces can be edited again
+    // as soon as this returns
+    pendingClusters = clusters;
+    prepare(pendingBuffers, pendingClusters, mp_context->supportsPackedNormals());
+    MeshBufferBuilder *b = &pendingBuffers;
+    MeshBufferSet *set = &pendingSet;
+    upload = uploader.submit([b, set](QOpenGLFunctions_3_2_Core &gl){
+        uploadBuffers(gl, *b, *set);
+    });
+}
+
+void Mesh::loadAsync(BufferUploader &uploader, const std::string &fileName)
+{
+    // Loading starts the iDs over, which mustn't show in the mesh being edited
+    int vertexCount = Vertex::counter;
+    int edgeCount = HalfEdge::counter;
+    int faceCount = Face::counter;
+    createFromOBJ(fileName);
+    Vertex::counter = vertexCount;
+    HalfEdge::counter = edgeCount;
+    Face::counter = faceCount;
+    createAsync(uploader);
+}
 
-        // The last normal is pushed back independently because to has to loop back to 0
-        normal = -glm::normalize(glm::cross(faceVerts[faceVerts.size() - 1].pos - faceVerts[0].pos,
-                                           faceVerts[faceVerts.size() - 1].pos - faceVerts[faceVerts.size() - 2].pos));
-        nor.push_back(glm::vec4(normal, 0));
-        faceVerts.clear();
+bool Mesh::swapPending()
+{
+    if (!upload || !upload->complete(*mp_context)){
+        return false;
     }
+    upload.reset();
+    std::swap(buffers, pendingBuffers);
+    std::swap(clusters, pendingClusters);
+    adopt(pendingSet);
+    pendingSet = MeshBufferSet();
+    return true;
+}
 
-    count = idx.size();
+bool Mesh::pending() const
+{
+    return upload != nullptr;
+}
 
-    generateIdx();
-    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+bool Mesh::dropPending()
+{
+    if (!upload){
+        return true;
+    }
+    if (!upload->done()){
+        return false;
+    }
+    if (upload->ran()){
+        upload->discard(*mp_context);
+        mp_context->glDeleteBuffers(1, &pendingSet.idx);
+        mp_context->glDeleteBuffers(1, &pendingSet.vert);
+        mp_context->glDeleteBuffers(1, &pendingSet.faceCol);
+        mp_context->glDeleteTextures(1, &pendingSet.texFaceCol);
+    }
+    upload.reset();
+    pendingSet = MeshBufferSet();
+    return true;
+}
 
-    generatePos();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufPos);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, pos.size() * sizeof(glm::vec4), pos.data(), GL_STATIC_DRAW);
+bool Mesh::updateVertex(Vertex *v)
+{
+    if (buffers.mode == MeshBufferBuilder::SHARED_VERTICES){
+        // With no normals stored, a vertex only appears in its own slot
+        int i = buffers.vertexIndex(vertices, v);
+        if (!vertBound || i < 0 || !buffers.refillVertex(vertices, i)){
+            return false;
+        }
+        int stride = buffers.layout.stride;
+        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufVert);
+        mp_context->glBufferSubData(GL_ARRAY_BUFFER, i * stride, stride, buffers.verts.data() + i * stride);
+
+        // Only the clusters around the vertex can have changed shape
+        std::vector<int> around;
+        if (buffers.facesAround(faces, v, around)){
+            clusters.refit(buffers, faces, around);
+        }
+        return true;
+    }
+
+    std::vector<int> changed;
+    if (!buffers.facesAround(faces, v, changed) || !updateFaces(changed)){
+        return false;
+    }
+    clusters.refit(buffers, faces, changed);
+    return true;
+}
 
-    generateNor();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufNor);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, nor.size() * sizeof(glm::vec4), nor.data(), GL_STATIC_DRAW);
+int Mesh::cull(const glm::mat4 &viewProj)
+{
+    std::vector<std::pair<int, int>> ranges;
+    int visible = clusters.cull(viewProj, ranges);
+    drawRanges(ranges);
+    return visible;
+}
 
-    generateCol();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufCol);
-    mp_context->glBufferData(GL_ARRAY_BUFFER, col.size() * sizeof(glm::vec4), col.data(), GL_STATIC_DRAW);
+bool Mesh::updateFace(Face *f)
+{
+    int index = buffers.faceIndex(faces, f);
+    if (index < 0){
+        return false;
+    }
+    std::vector<int> changed(1, index);
+    return updateFaces(changed);
+}
 
-    if (vertsBound){
-        generateJnt();
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufJnt);
-        mp_context->glBufferData(GL_ARRAY_BUFFER, jnt.size() * sizeof(GLuint), jnt.data(), GL_STATIC_DRAW);
+bool Mesh::updateFaces(std::vector<int> &changed)
+{
+    bool shared = buffers.mode == MeshBufferBuilder::SHARED_VERTICES;
+    if (!(shared ? faceColBound : vertBound) || !buffers.refillFaces(faces, changed)){
+        return false;
+    }
 
-        generateInf();
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, bufInf);
-        mp_context->glBufferData(GL_ARRAY_BUFFER, inf.size() * sizeof(GLfloat), inf.data(), GL_STATIC_DRAW);
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+    // The index buffer only depends on the face valences, so just the face
+    // corners, or the triangle colours for shared vertices, are uploaded again
+    GLenum target = shared ? GL_TEXTURE_BUFFER : GL_ARRAY_BUFFER;
+    const GLubyte *data = shared ? reinterpret_cast<const GLubyte*>(buffers.faceCols.data()) : buffers.verts.data();
+    auto offset = [&](int f){
+        return shared ? buffers.firstTriangle(f) * int(sizeof(GLuint)) : buffers.firstCorner(f) * buffers.layout.stride;
+    };
+    mp_context->glBindBuffer(target, shared ? bufFaceCol : bufVert);
+    size_t i = 0;
+    while (i < changed.size()){
+        size_t j = i + 1;
+        while (j < changed.size() && changed[j] == changed[j - 1] + 1){
+            j++;
+        }
+        int begin = offset(changed[i]);
+        int end = offset(changed[j - 1] + 1);
+        mp_context->glBufferSubData(target, begin, end - begin, data + begin);
+        i = j;
     }
+    return true;
 }
 
 Mesh::~Mesh()
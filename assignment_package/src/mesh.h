@@ -8,8 +8,19 @@
 #include <memory>
 #include <vector>
 #include <drawable.h>
+#include <meshbufferbuilder.h>
+#include <meshclusters.h>
+#include <bufferuploader.h>
 #include <fstream>
 
+// The buffers of one build of a Mesh, made by whichever thread uploaded it
+struct MeshBufferSet {
+    GLuint idx = 0;
+    GLuint vert = 0;
+    GLuint faceCol = 0;    // with texFaceCol, only for SHARED_VERTICES builds
+    GLuint texFaceCol = 0;
+};
+
 class Mesh : public Drawable
 {
 public:
@@ -25,8 +36,63 @@ public:
     Vertex *vertPtr(int index);
     Face *facePtr(int index);
 
+    // Holds the VBO contents between calls to create() so their storage is reused
+    MeshBufferBuilder buffers;
+
+    // The faces in groups of nearby triangles, laid out one after another in
+    // the index buffer by create(), for cull()
+    MeshClusters clusters;
+
+    // Uploads every vertex once and colours the triangles from a buffer
+    // texture instead of giving each face corner its own vertex. Takes effect
+    // on the next create().
+    bool sharedVertices;
+
+    // Stores the joints and influences of bound vertices, for drawing the mesh
+    // skinned. Takes effect on the next create().
+    bool skinned;
+
     void create() override;
 
+    // create() in the background: the buffers of the current faces are built
+    // here, but uploaded into a new set by uploader's thread, and the mesh
+    // goes on drawing the set it has until swapPending() swaps the new one
+    // in. Edits to the mesh have to wait for that, as they'd be missing from
+    // the new set.
+    void createAsync(BufferUploader &uploader);
+    // Loads an .obj file into the mesh and hands its buffers to uploader's
+    // thread, like createAsync(). The file is read here, as the mesh's
+    // components are list items, which belong to the GUI thread.
+    void loadAsync(BufferUploader &uploader, const std::string &fileName);
+    // Swaps in the buffers of the last createAsync() or loadAsync() if the
+    // GPU has all of them, and returns whether it did
+    bool swapPending();
+    // Whether there's a set waiting to be swapped in
+    bool pending() const;
+    // Deletes the buffers of the upload in progress, if any, and returns
+    // true once it's gone. An upload still running on the thread is left
+    // alone and false is returned, so the mesh has to be kept and this called
+    // again later rather than waiting for it.
+    bool dropPending();
+
+    // Limits the next draws to the clusters that may be inside the frustum of
+    // viewProj, and returns how many that is. Only valid for the mesh's own
+    // positions, so not while it's drawn skinned.
+    int cull(const glm::mat4 &viewProj);
+
+    // Write an edit to the positions or influences of v, or to the colour of
+    // f, back into the buffers, uploading only the vertices, corners or
+    // triangle colours involved. They return false and leave the buffers alone if the topology
+    // changed since the last create(), which then has to be called instead.
+    bool updateVertex(Vertex *v);
+    bool updateFace(Face *f);
+
+    // Returns 3 or 4 if every face in the mesh has that many vertices, and 0
+    // otherwise. Used to pick the fixed-size Catmull-Clark steps for pure
+    // triangle and pure quad meshes; MeshBufferBuilder works the same out
+    // for its fill while it counts the corners.
+    int uniformArity();
+
     // This function creates a cube in the mesh instance
     void createCube();
 
@@ -45,6 +111,28 @@ public:
     void resetMesh();
 
     ~Mesh();
+
+private:
+    // The build being uploaded by createAsync() or loadAsync(), which
+    // replaces buffers, clusters and the drawn buffers once it's complete
+    MeshBufferBuilder pendingBuffers;
+    MeshClusters pendingClusters;
+    MeshBufferSet pendingSet;
+    std::shared_ptr<BufferUploader::Upload> upload;
+
+    // Sorts the faces into clusters and builds their buffer contents into b
+    // and c. Makes no GL calls, so it can run on any thread.
+    void prepare(MeshBufferBuilder &b, MeshClusters &c, bool packedNormals);
+
+    // Creates a set of buffers holding b's contents, with gl's context current
+    static void uploadBuffers(QOpenGLFunctions_3_2_Core &gl, const MeshBufferBuilder &b, MeshBufferSet &set);
+
+    // Replaces the buffers drawn with set, which holds the contents of buffers
+    void adopt(const MeshBufferSet &set);
+
+    // Refills the given faces and uploads the corner ranges they cover,
+    // merging ranges that touch into one glBufferSubData
+    bool updateFaces(std::vector<int> &changed);
 };
 
 #endif // MESH_H
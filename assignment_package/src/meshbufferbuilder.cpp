@@ -0,0 +1,418 @@
+#include "meshbufferbuilder.h"
+#include <vertex.h>
+#include <halfedge.h>
+#include <parallel.h>
+#include <atomic>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+// Faces and vertices are cheap to fill, so threads only pay off on fairly
+// large meshes
+static const int FACES_PER_THREAD = 16384;
+static const int VERTICES_PER_THREAD = 32768;
+
+// Signed normalized 10 bit x, y and z with w left at 0
+static GLuint packNormal1010102(const glm::vec3 &n)
+{
+    auto component = [](float v){
+        return GLuint(int(std::round(glm::clamp(v, -1.f, 1.f) * 511.f)) & 0x3FF);
+    };
+    return component(n.x) | (component(n.y) << 10) | (component(n.z) << 20);
+}
+
+// Signed normalized bytes x, y, z and 0, in memory order
+static GLuint packNormalBytes(const glm::vec3 &n)
+{
+    GLbyte bytes[4];
+    for (int i = 0; i < 3; i++){
+        bytes[i] = GLbyte(std::round(glm::clamp(n[i], -1.f, 1.f) * 127.f));
+    }
+    bytes[3] = 0;
+    GLuint packed;
+    std::memcpy(&packed, bytes, 4);
+    return packed;
+}
+
+GLuint packColour(const glm::vec3 &c)
+{
+    GLubyte bytes[4];
+    for (int i = 0; i < 3; i++){
+        bytes[i] = GLubyte(std::round(glm::clamp(c[i], 0.f, 1.f) * 255.f));
+    }
+    bytes[3] = 255;
+    GLuint packed;
+    std::memcpy(&packed, bytes, 4);
+    return packed;
+}
+
+MeshBufferBuilder::MeshBufferBuilder()
+    : arity(0), skinOffset(0), vertFacesBuilt(false), mode(SHARED_VERTICES), skinned(false), vertsBound(false),
+      packedNormals(true), threadCount(0), fixedArity(true)
+{}
+
+int MeshBufferBuilder::vertexCount()
+{
+    return layout.stride > 0 ? verts.size() / layout.stride : 0;
+}
+
+glm::vec3 &MeshBufferBuilder::position(int i)
+{
+    return *reinterpret_cast<glm::vec3*>(&verts[i * layout.stride]);
+}
+
+PackedVertex &MeshBufferBuilder::vertex(int i)
+{
+    return *reinterpret_cast<PackedVertex*>(&verts[i * layout.stride]);
+}
+
+PackedSkin &MeshBufferBuilder::skin(int i)
+{
+    return *reinterpret_cast<PackedSkin*>(&verts[i * layout.stride + skinOffset]);
+}
+
+Face *MeshBufferBuilder::faceAt(std::vector<uPtr<Face>> &faces, int f)
+{
+    return faces[faceOrder.empty() ? f : faceOrder[f]].get();
+}
+
+VertexLayout MeshBufferBuilder::vertexLayout(Layout mode, bool packedNormals)
+{
+    VertexLayout layout;
+    if (mode == SHARED_VERTICES){
+        layout.attributes.push_back({VertexAttribute::POS, 3, GL_FLOAT, GL_FALSE, false, 0});
+        layout.stride = sizeof(glm::vec3);
+    } else {
+        layout.attributes.push_back({VertexAttribute::POS, 3, GL_FLOAT, GL_FALSE, false, int(offsetof(PackedVertex, pos))});
+        layout.attributes.push_back({VertexAttribute::NOR, 4, GLenum(packedNormals ? GL_INT_2_10_10_10_REV : GL_BYTE),
+                                     GL_TRUE, false, int(offsetof(PackedVertex, nor))});
+        layout.attributes.push_back({VertexAttribute::COL, 4, GL_UNSIGNED_BYTE, GL_TRUE, false, int(offsetof(PackedVertex, col))});
+        layout.stride = sizeof(PackedVertex);
+    }
+    return layout;
+}
+
+void MeshBufferBuilder::build(std::vector<uPtr<Face>> &faces, std::vector<uPtr<Vertex>> &vertices,
+                              Layout l, bool packed, bool skin, const std::vector<int> &order)
+{
+    int faceCount = faces.size();
+    int vertCount = vertices.size();
+    faceOrder = order;
+    faceStart.resize(faceCount + 1);
+    faceStart[0] = 0;
+
+    // Valences first, stored one slot ahead so the prefix sum can run in place
+    std::atomic<bool> anyBound(false);
+    parallelRanges(faceCount, FACES_PER_THREAD, [&](int begin, int end){
+        bool bound = false;
+        for (int f = begin; f < end; f++){
+            HalfEdge *first = faceAt(faces, f)->edge;
+            HalfEdge *e = first;
+            int n = 0;
+            do {
+                bound = bound || e->vert->bound;
+                n++;
+                e = e->next;
+            } while (e != first);
+            faceStart[f + 1] = n;
+        }
+        if (bound){
+            anyBound = true;
+        }
+    }, threadCount);
+    arity = fixedArity && faceCount > 0 ? faceStart[1] : 0;
+    for (int f = 0; f < faceCount; f++){
+        if (faceStart[f + 1] != arity){
+            arity = 0;
+        }
+        faceStart[f + 1] += faceStart[f];
+    }
+    if (arity != 3 && arity != 4){
+        arity = 0;
+    }
+    mode = l;
+    skinned = skin;
+    vertsBound = skin && anyBound;
+    packedNormals = packed;
+
+    layout = vertexLayout(mode, packedNormals);
+    skinOffset = layout.stride;
+    if (vertsBound){
+        layout.attributes.push_back({VertexAttribute::JNT, 2, GL_UNSIGNED_SHORT, GL_FALSE, true, skinOffset + int(offsetof(PackedSkin, jnt))});
+        layout.attributes.push_back({VertexAttribute::INF, 2, GL_UNSIGNED_SHORT, GL_TRUE, false, skinOffset + int(offsetof(PackedSkin, inf))});
+        layout.stride += sizeof(PackedSkin);
+    }
+
+    // A face with n corners adds n - 2 triangles
+    int corners = faceStart[faceCount];
+    int triangles = corners - 2 * faceCount;
+    idx.resize(3 * triangles);
+    if (mode == SHARED_VERTICES){
+        // The faces refer to their vertices by iD, which is turned into an
+        // index into verts through vertSlot
+        unsigned int maxID = 0;
+        for (uPtr<Vertex> &v : vertices){
+            maxID = std::max(maxID, v->iD);
+        }
+        vertSlot.assign(vertCount > 0 ? maxID + 1 : 0, -1);
+        for (int i = 0; i < vertCount; i++){
+            vertSlot[vertices[i]->iD] = i;
+        }
+        verts.resize(vertCount * layout.stride);
+        faceCols.resize(triangles);
+        parallelRanges(vertCount, VERTICES_PER_THREAD, [&](int begin, int end){
+            fillVertices(vertices, begin, end);
+        }, threadCount);
+    } else {
+        vertSlot.clear();
+        faceCols.clear();
+        verts.resize(corners * layout.stride);
+    }
+
+    parallelRanges(faceCount, FACES_PER_THREAD, [&](int begin, int end){
+        fillFaces(faces, begin, end);
+    }, threadCount);
+
+    unsigned int maxID = 0;
+    for (uPtr<Face> &f : faces){
+        maxID = std::max(maxID, f->iD);
+    }
+    faceSlot.assign(faceCount > 0 ? maxID + 1 : 0, -1);
+    for (int f = 0; f < faceCount; f++){
+        faceSlot[faceAt(faces, f)->iD] = f;
+    }
+    vertFacesBuilt = false;
+}
+
+int MeshBufferBuilder::faceIndex(std::vector<uPtr<Face>> &faces, Face *f)
+{
+    if (f->iD >= faceSlot.size()){
+        return -1;
+    }
+    int slot = faceSlot[f->iD];
+    if (slot < 0 || slot >= int(faces.size()) || faceAt(faces, slot) != f){
+        return -1;
+    }
+    return slot;
+}
+
+// Buckets the corners of every face by vertex iD, the same way the smoother
+// lays out its one-rings
+void MeshBufferBuilder::buildVertFaces(std::vector<uPtr<Face>> &faces)
+{
+    int faceCount = faceStart.size() - 1;
+    unsigned int maxID = 0;
+    for (int f = 0; f < faceCount; f++){
+        HalfEdge *first = faceAt(faces, f)->edge;
+        HalfEdge *e = first;
+        do {
+            maxID = std::max(maxID, e->vert->iD);
+            e = e->next;
+        } while (e != first);
+    }
+    vertFaceStart.assign(maxID + 2, 0);
+    for (int f = 0; f < faceCount; f++){
+        HalfEdge *first = faceAt(faces, f)->edge;
+        HalfEdge *e = first;
+        do {
+            vertFaceStart[e->vert->iD + 1]++;
+            e = e->next;
+        } while (e != first);
+    }
+    for (unsigned int i = 0; i <= maxID; i++){
+        vertFaceStart[i + 1] += vertFaceStart[i];
+    }
+    vertFaces.resize(vertFaceStart.back());
+    std::vector<int> fill(vertFaceStart.begin(), vertFaceStart.end() - 1);
+    for (int f = 0; f < faceCount; f++){
+        HalfEdge *first = faceAt(faces, f)->edge;
+        HalfEdge *e = first;
+        do {
+            vertFaces[fill[e->vert->iD]++] = f;
+            e = e->next;
+        } while (e != first);
+    }
+    vertFacesBuilt = true;
+}
+
+bool MeshBufferBuilder::facesAround(std::vector<uPtr<Face>> &faces, Vertex *v, std::vector<int> &out)
+{
+    if (!vertFacesBuilt){
+        buildVertFaces(faces);
+    }
+    if (v->iD + 1 >= vertFaceStart.size() || vertFaceStart[v->iD] == vertFaceStart[v->iD + 1]){
+        return false;
+    }
+    out.insert(out.end(), vertFaces.begin() + vertFaceStart[v->iD], vertFaces.begin() + vertFaceStart[v->iD + 1]);
+    return true;
+}
+
+int MeshBufferBuilder::vertexIndex(std::vector<uPtr<Vertex>> &vertices, Vertex *v)
+{
+    if (v->iD >= vertSlot.size()){
+        return -1;
+    }
+    int slot = vertSlot[v->iD];
+    if (slot < 0 || slot >= int(vertices.size()) || vertices[slot].get() != v){
+        return -1;
+    }
+    return slot;
+}
+
+int MeshBufferBuilder::fillArity()
+{
+    return arity;
+}
+
+int MeshBufferBuilder::firstCorner(int f)
+{
+    return faceStart[f];
+}
+
+int MeshBufferBuilder::firstTriangle(int f)
+{
+    return faceStart[f] - 2 * f;
+}
+
+bool MeshBufferBuilder::refillVertex(std::vector<uPtr<Vertex>> &vertices, int i)
+{
+    if (vertices[i]->bound && skinned && !vertsBound){
+        return false;
+    }
+    fillVertices(vertices, i, i + 1);
+    return true;
+}
+
+bool MeshBufferBuilder::refillFaces(std::vector<uPtr<Face>> &faces, const std::vector<int> &changed)
+{
+    for (int f : changed){
+        if (f + 1 >= int(faceStart.size()) || f >= int(faces.size())){
+            return false;
+        }
+        HalfEdge *first = faceAt(faces, f)->edge;
+        HalfEdge *e = first;
+        int n = 0;
+        do {
+            if (e->vert->bound && skinned && !vertsBound){
+                return false;
+            }
+            if (mode == SHARED_VERTICES && (e->vert->iD >= vertSlot.size() || vertSlot[e->vert->iD] < 0)){
+                return false;
+            }
+            n++;
+            e = e->next;
+        } while (e != first);
+        if (n != faceStart[f + 1] - faceStart[f]){
+            return false;
+        }
+    }
+    for (int f : changed){
+        fillFaces(faces, f, f + 1);
+    }
+    return true;
+}
+
+void MeshBufferBuilder::fillSkin(PackedSkin &s, Vertex *v)
+{
+    if (v->bound){
+        s.jnt[0] = v->skin[0]->iD;
+        s.jnt[1] = v->skin[1]->iD;
+        s.inf[0] = GLushort(std::round(glm::clamp(v->influence[0], 0.f, 1.f) * 65535.f));
+        s.inf[1] = GLushort(std::round(glm::clamp(v->influence[1], 0.f, 1.f) * 65535.f));
+    } else {
+        s.jnt[0] = s.jnt[1] = 0;
+        s.inf[0] = s.inf[1] = 0;
+    }
+}
+
+void MeshBufferBuilder::fillVertices(std::vector<uPtr<Vertex>> &vertices, int begin, int end)
+{
+    for (int i = begin; i < end; i++){
+        position(i) = vertices[i]->pos;
+        if (vertsBound){
+            fillSkin(skin(i), vertices[i].get());
+        }
+    }
+}
+
+void MeshBufferBuilder::fillFaces(std::vector<uPtr<Face>> &faces, int begin, int end)
+{
+    switch (arity){
+    case 3:
+        fillFaces<3>(faces, begin, end);
+        break;
+    case 4:
+        fillFaces<4>(faces, begin, end);
+        break;
+    default:
+        fillFaces<0>(faces, begin, end);
+        break;
+    }
+}
+
+// With N fixed, the corner offsets come straight from the slot and every
+// loop over the corners has a constant trip count, so they're unrolled
+template <int N>
+void MeshBufferBuilder::fillFaces(std::vector<uPtr<Face>> &faces, int begin, int end)
+{
+    for (int f = begin; f < end; f++){
+        Face *face = faceAt(faces, f);
+        int first = N > 0 ? N * f : faceStart[f];
+        int n = N > 0 ? N : faceStart[f + 1] - first;
+        GLuint *tri = &idx[3 * (first - 2 * f)];
+
+        if (mode == SHARED_VERTICES){
+            // Fan over the face's own vertices, with the face colour repeated
+            // for each of its triangles
+            HalfEdge *e = face->edge;
+            GLuint pivot = vertSlot[e->vert->iD];
+            e = e->next;
+            for (int i = 1; i < n - 1; i++){
+                *tri++ = pivot;
+                *tri++ = vertSlot[e->vert->iD];
+                *tri++ = vertSlot[e->next->vert->iD];
+                e = e->next;
+            }
+            GLuint faceCol = packColour(face->colour);
+            std::fill(faceCols.begin() + (first - 2 * f), faceCols.begin() + (first - 2 * f + n - 2), faceCol);
+            continue;
+        }
+
+        HalfEdge *e = face->edge;
+        for (int i = 0; i < n; i++){
+            Vertex *v = e->vert;
+            vertex(first + i).pos = v->pos;
+            if (vertsBound){
+                fillSkin(skin(first + i), v);
+            }
+            e = e->next;
+        }
+
+        // One normal per face from Newell's method, which doesn't depend on
+        // which corner it's measured at. Negated to keep the winding the
+        // shaders expect.
+        glm::vec3 normal(0.f);
+        for (int i = 0; i < n; i++){
+            int j = i + 1 == n ? 0 : i + 1;
+            normal += glm::cross(vertex(first + i).pos, vertex(first + j).pos);
+        }
+        float len = glm::length(normal);
+        if (len > 0.f){
+            normal = -normal / len;
+        }
+        GLuint faceNor = packedNormals ? packNormal1010102(normal) : packNormalBytes(normal);
+        GLuint faceCol = packColour(face->colour);
+        for (int i = 0; i < n; i++){
+            PackedVertex &v = vertex(first + i);
+            v.nor = faceNor;
+            v.col = faceCol;
+        }
+
+        for (int i = 1; i < n - 1; i++){
+            *tri++ = first;
+            *tri++ = first + i;
+            *tri++ = first + i + 1;
+        }
+    }
+}
@@ -0,0 +1,177 @@
+#ifndef MESHBUFFERBUILDER_H
+#define MESHBUFFERBUILDER_H
+
+#include <la.h>
+#include <face.h>
+#include <vertex.h>
+#include <drawable.h>
+#include <smartpointerhelp.h>
+#include <vector>
+
+// A face corner as uploaded by Mesh::create (20 bytes instead of three vec4s)
+struct PackedVertex {
+    glm::vec3 pos;
+    GLuint nor;  // signed normalized 2_10_10_10, or four signed bytes without packed normal support
+    GLuint col;  // RGBA8
+};
+
+// Packs c as the RGBA8 colour of a face corner or triangle, opaque
+GLuint packColour(const glm::vec3 &c);
+
+// Appended to every vertex of a mesh bound to a skeleton (8 bytes instead of
+// two ints and two floats). Joint iDs are 16 bit, which covers every joint
+// the skin palette's texture buffer is guaranteed to hold.
+struct PackedSkin {
+    GLushort jnt[2];
+    GLushort inf[2];  // unsigned normalized
+};
+
+// Builds the VBO contents of a Mesh, in one of two layouts:
+//  * SHARED_VERTICES: every mesh vertex once (position, plus the joint iDs and
+//    influences when the mesh is bound to a skeleton), fan triangulated
+//    indices into them, and one colour per triangle in faceCols, which the
+//    shaders read through a buffer texture indexed by gl_PrimitiveID.
+//  * FACE_CORNERS: one interleaved vertex per face corner with the flat
+//    normal and colour of its face, and indices into each face's own corners.
+// The exact size of every array is known from a prefix sum over the face
+// valences before anything is written, so the faces are filled in parallel
+// straight into their slots. The arrays are kept between builds, so refreshing
+// a mesh that didn't grow allocates nothing.
+// Edits that keep the topology (moving a vertex, recolouring a face, changing
+// an influence) are written back into the same slots with refillVertex() and
+// refillFaces(), so only what they touch has to be uploaded again.
+// The faces can be laid out in any order (see MeshClusters). Every face index
+// taken or returned by the builder is its slot in that order, and faceAt()
+// turns one back into a face.
+class MeshBufferBuilder
+{
+private:
+    // faceStart[f] is the first corner of slot f, faceStart.back() the corner count
+    std::vector<int> faceStart;
+
+    // 3 or 4 if every face in the last build has that many corners, or 0
+    int arity;
+
+    // The index into faces of every slot, or empty if they're in order
+    std::vector<int> faceOrder;
+
+    // The index of every vertex in the last build, by vertex iD, or -1. Only
+    // kept for SHARED_VERTICES.
+    std::vector<int> vertSlot;
+
+    // Where the PackedSkin of a vertex starts
+    int skinOffset;
+
+    // The index of every face in the last build, by face iD, or -1
+    std::vector<int> faceSlot;
+
+    // The faces around every vertex, by vertex iD: vertFaces[vertFaceStart[iD]]
+    // to vertFaces[vertFaceStart[iD + 1] - 1]. Only built on the first
+    // facesAround() after a build, since most builds are never edited.
+    std::vector<int> vertFaceStart;
+    std::vector<int> vertFaces;
+    bool vertFacesBuilt;
+
+    void buildVertFaces(std::vector<uPtr<Face>> &faces);
+
+    // Write faces [begin, end) and vertices [begin, end) into the arrays.
+    // fillFaces<N>() is the loop for faces of exactly N corners, or of any
+    // number for N = 0, and fillFaces() picks the one for the build's arity.
+    void fillFaces(std::vector<uPtr<Face>> &faces, int begin, int end);
+    template <int N>
+    void fillFaces(std::vector<uPtr<Face>> &faces, int begin, int end);
+    void fillVertices(std::vector<uPtr<Vertex>> &vertices, int begin, int end);
+    void fillSkin(PackedSkin &s, Vertex *v);
+
+public:
+    enum Layout {
+        SHARED_VERTICES,
+        FACE_CORNERS
+    };
+
+    MeshBufferBuilder();
+
+    // The layout used by the last build
+    Layout mode;
+
+    // The interleaved vertices, each stride bytes long: a glm::vec3 position
+    // (SHARED_VERTICES) or a PackedVertex (FACE_CORNERS), followed by a
+    // PackedSkin if vertsBound
+    std::vector<GLubyte> verts;
+    std::vector<GLuint> idx;
+
+    // RGBA8 colour of every triangle, SHARED_VERTICES only
+    std::vector<GLuint> faceCols;
+
+    // The attributes in verts, for ShaderProgram::draw
+    VertexLayout layout;
+
+    // Whether build() was asked to store the skinning data of bound vertices
+    bool skinned;
+
+    // Set by build() if skinned and any vertex is bound to a joint
+    bool vertsBound;
+
+    // Whether normals are stored as 2_10_10_10 instead of four bytes
+    bool packedNormals;
+
+    // Number of threads the faces are split over; 0 uses one per hardware thread
+    int threadCount;
+
+    // Whether pure triangle and pure quad meshes (anything that went through
+    // Catmull-Clark, say) are filled by loops unrolled over their corners
+    bool fixedArity;
+
+    // The arity the last build was filled for: 3 or 4 if every face has that
+    // many corners and fixedArity was set, or 0 for the general loop
+    int fillArity();
+
+    int vertexCount();
+    glm::vec3 &position(int i);
+    PackedVertex &vertex(int i);  // FACE_CORNERS only
+    PackedSkin &skin(int i);
+
+    // The attributes of a vertex in the given layout, without skinning data.
+    // Also used by other Drawables that upload vertices in the same format.
+    static VertexLayout vertexLayout(Layout mode, bool packedNormals);
+
+    // Leaves out the joints and influences unless skin is set, so meshes that
+    // aren't drawn skinned don't upload them. order gives the index into
+    // faces of every slot; if it's empty the faces keep their own order.
+    void build(std::vector<uPtr<Face>> &faces, std::vector<uPtr<Vertex>> &vertices,
+               Layout layout, bool packedNormals, bool skin,
+               const std::vector<int> &order = std::vector<int>());
+
+    // The face in slot f of the last build
+    Face *faceAt(std::vector<uPtr<Face>> &faces, int f);
+
+    // Returns the index of f in the last build, or -1 if f wasn't part of it
+    int faceIndex(std::vector<uPtr<Face>> &faces, Face *f);
+
+    // Returns the index of v in verts, or -1 if it wasn't part of the last
+    // build. SHARED_VERTICES only.
+    int vertexIndex(std::vector<uPtr<Vertex>> &vertices, Vertex *v);
+
+    // Appends the indices of the faces that have v as a corner to out. Returns
+    // false if v wasn't a corner of any face in the last build.
+    bool facesAround(std::vector<uPtr<Face>> &faces, Vertex *v, std::vector<int> &out);
+
+    // Corners firstCorner(f) to firstCorner(f + 1) - 1 belong to face f, and so
+    // do triangles firstTriangle(f) to firstTriangle(f + 1) - 1
+    int firstCorner(int f);
+    int firstTriangle(int f);
+
+    // Rewrites vertex i of a SHARED_VERTICES build from the current position
+    // and influences. Returns false if it gained a skinned corner in a build
+    // without skinning data.
+    bool refillVertex(std::vector<uPtr<Vertex>> &vertices, int i);
+
+    // Rewrites the given faces in place from the current positions, colours
+    // and influences (only their triangle colours for SHARED_VERTICES).
+    // Returns false without writing anything if one of them no longer has the
+    // valence or the vertices it was built with, or gained a skinned corner in
+    // a build without skinning data, in which case build() has to run again.
+    bool refillFaces(std::vector<uPtr<Face>> &faces, const std::vector<int> &changed);
+};
+
+#endif // MESHBUFFERBUILDER_H
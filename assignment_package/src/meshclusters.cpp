@@ -0,0 +1,361 @@
+#include "meshclusters.h"
+#include <halfedge.h>
+#include <vertex.h>
+#include <parallel.h>
+#include <algorithm>
+#include <limits>
+
+static const int FACES_PER_THREAD = 16384;
+
+// Gribb and Hartmann: every plane is a sum or difference of the fourth row of
+// the matrix and one of the others
+Frustum::Frustum(const glm::mat4 &viewProj)
+{
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++){
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    for (int i = 0; i < 3; i++){
+        planes[2 * i] = rows[3] + rows[i];
+        planes[2 * i + 1] = rows[3] - rows[i];
+    }
+    for (glm::vec4 &p : planes){
+        p /= glm::length(glm::vec3(p));
+    }
+}
+
+bool Frustum::intersects(const glm::vec3 &centre, float radius) const
+{
+    for (const glm::vec4 &p : planes){
+        if (glm::dot(glm::vec3(p), centre) + p.w < -radius){
+            return false;
+        }
+    }
+    return true;
+}
+
+// Only the corner furthest along each plane's normal has to be checked
+bool Frustum::intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    for (const glm::vec4 &p : planes){
+        glm::vec3 corner(p.x >= 0.f ? boxMax.x : boxMin.x,
+                         p.y >= 0.f ? boxMax.y : boxMin.y,
+                         p.z >= 0.f ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(p), corner) + p.w < 0.f){
+            return false;
+        }
+    }
+    return true;
+}
+
+MeshClusters::MeshClusters()
+    : clusters(), order(), targetTriangles(512), threadCount(0), cacheSize(16)
+{}
+
+// Spreads the low 10 bits of v out to every third bit
+static unsigned int spreadBits(unsigned int v)
+{
+    v &= 0x3FF;
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+void MeshClusters::sort(std::vector<uPtr<Face>> &faces)
+{
+    int faceCount = faces.size();
+    std::vector<glm::vec3> centroids(faceCount);
+    parallelRanges(faceCount, FACES_PER_THREAD, [&](int begin, int end){
+        for (int f = begin; f < end; f++){
+            glm::vec3 sum(0.f);
+            int n = 0;
+            HalfEdge *first = faces[f]->edge;
+            HalfEdge *e = first;
+            do {
+                sum += e->vert->pos;
+                n++;
+                e = e->next;
+            } while (e != first);
+            centroids[f] = sum / float(n);
+        }
+    }, threadCount);
+
+    glm::vec3 lo(std::numeric_limits<float>::max());
+    glm::vec3 hi(-std::numeric_limits<float>::max());
+    for (const glm::vec3 &c : centroids){
+        lo = glm::min(lo, c);
+        hi = glm::max(hi, c);
+    }
+    glm::vec3 scale = 1023.f / glm::max(hi - lo, glm::vec3(1e-6f));
+
+    // Faces close together on the curve are close together in space, so
+    // consecutive runs of them make compact clusters
+    std::vector<std::pair<unsigned int, int>> keyed(faceCount);
+    for (int f = 0; f < faceCount; f++){
+        glm::vec3 q = (centroids[f] - lo) * scale;
+        keyed[f] = std::make_pair(spreadBits(unsigned(q.x)) | (spreadBits(unsigned(q.y)) << 1)
+                                  | (spreadBits(unsigned(q.z)) << 2), f);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    order.resize(faceCount);
+    for (int s = 0; s < faceCount; s++){
+        order[s] = keyed[s].second;
+    }
+}
+
+void MeshClusters::reorder(std::vector<uPtr<Face>> &faces)
+{
+    int faceCount = faces.size();
+    if (int(order.size()) != faceCount){
+        return;
+    }
+
+    // The corners of every face as vertex numbers, and the faces around
+    // every vertex
+    std::vector<int> number;
+    std::vector<int> cornerStart(faceCount + 1, 0);
+    std::vector<int> corners;
+    int vertexCount = 0;
+    for (int f = 0; f < faceCount; f++){
+        HalfEdge *first = faces[f]->edge;
+        HalfEdge *e = first;
+        do {
+            unsigned int id = e->vert->iD;
+            if (id >= number.size()){
+                number.resize(id + 1, -1);
+            }
+            if (number[id] < 0){
+                number[id] = vertexCount++;
+            }
+            corners.push_back(number[id]);
+            e = e->next;
+        } while (e != first);
+        cornerStart[f + 1] = corners.size();
+    }
+    std::vector<int> aroundStart(vertexCount + 1, 0);
+    for (int c : corners){
+        aroundStart[c + 1]++;
+    }
+    for (int v = 0; v < vertexCount; v++){
+        aroundStart[v + 1] += aroundStart[v];
+    }
+    std::vector<int> around(corners.size());
+    std::vector<int> fill(aroundStart.begin(), aroundStart.end() - 1);
+    for (int f = 0; f < faceCount; f++){
+        for (int i = cornerStart[f]; i < cornerStart[f + 1]; i++){
+            around[fill[corners[i]]++] = f;
+        }
+    }
+
+    // A vertex is in the cache if fewer than cacheSize vertices have been
+    // transformed since its stamp. live counts the faces of the current run
+    // that still need it.
+    std::vector<int> stamp(vertexCount, 0);
+    std::vector<int> live(vertexCount, 0);
+    std::vector<int> run(faceCount, -1);
+    std::vector<char> emitted(faceCount, 0);
+    std::vector<int> deadEnd;
+    std::vector<int> candidates;
+    std::vector<int> reordered;
+    reordered.reserve(faceCount);
+    int time = cacheSize + 1;
+
+    // Reordering within a run keeps its triangle count, so the runs cut here
+    // are the clusters split() finds after the build
+    cut(faceCount, [&](int s){
+        int f = order[s];
+        return cornerStart[f + 1] - cornerStart[f] - 2;
+    });
+    for (int r = 0; r < int(runEnds.size()); r++){
+        int begin = r == 0 ? 0 : runEnds[r - 1];
+        int end = runEnds[r];
+        for (int s = begin; s < end; s++){
+            int f = order[s];
+            run[f] = r;
+            for (int i = cornerStart[f]; i < cornerStart[f + 1]; i++){
+                live[corners[i]]++;
+            }
+        }
+        int next = begin;
+        deadEnd.clear();
+
+        int fan = corners[cornerStart[order[begin]]];
+        while (fan >= 0){
+            candidates.clear();
+            for (int a = aroundStart[fan]; a < aroundStart[fan + 1]; a++){
+                int f = around[a];
+                if (emitted[f] || run[f] != r){
+                    continue;
+                }
+                emitted[f] = 1;
+                reordered.push_back(f);
+                for (int i = cornerStart[f]; i < cornerStart[f + 1]; i++){
+                    int c = corners[i];
+                    deadEnd.push_back(c);
+                    candidates.push_back(c);
+                    live[c]--;
+                    if (time - stamp[c] > cacheSize){
+                        stamp[c] = time++;
+                    }
+                }
+            }
+
+            // The oldest vertex that will still be in the cache after fanning
+            // around it, or any other with faces left, so that it gets fanned
+            // before dropping out
+            fan = -1;
+            int best = -1;
+            for (int c : candidates){
+                if (live[c] <= 0){
+                    continue;
+                }
+                int age = time - stamp[c];
+                int priority = age + 2 * live[c] <= cacheSize ? age : 0;
+                if (priority > best){
+                    best = priority;
+                    fan = c;
+                }
+            }
+            // Otherwise the most recently used vertex with faces left, and
+            // failing that the first face of the run not drawn yet
+            while (fan < 0 && !deadEnd.empty()){
+                if (live[deadEnd.back()] > 0){
+                    fan = deadEnd.back();
+                }
+                deadEnd.pop_back();
+            }
+            while (fan < 0 && next < end){
+                int f = order[next++];
+                if (!emitted[f]){
+                    fan = corners[cornerStart[f]];
+                }
+            }
+        }
+    }
+    order.swap(reordered);
+}
+
+float MeshClusters::acmr(std::vector<uPtr<Face>> &faces, const std::vector<int> &order)
+{
+    // A vertex is in the FIFO if fewer than cacheSize misses came after its own
+    std::vector<int> entered;
+    int misses = 0;
+    int triangles = 0;
+    auto transform = [&](Vertex *v){
+        if (v->iD >= entered.size()){
+            entered.resize(v->iD + 1, -1);
+        }
+        int &e = entered[v->iD];
+        if (e < 0 || misses - e >= cacheSize){
+            e = misses++;
+        }
+    };
+
+    int faceCount = faces.size();
+    for (int s = 0; s < faceCount; s++){
+        Face *face = faces[order.empty() ? s : order[s]].get();
+        HalfEdge *pivot = face->edge;
+        for (HalfEdge *e = pivot->next; e->next != pivot; e = e->next){
+            transform(pivot->vert);
+            transform(e->vert);
+            transform(e->next->vert);
+            triangles++;
+        }
+    }
+    return triangles > 0 ? float(misses) / triangles : 0.f;
+}
+
+void MeshClusters::cut(int slotCount, const std::function<int(int)> &trianglesIn)
+{
+    runEnds.clear();
+    int s = 0;
+    while (s < slotCount){
+        int triangles = 0;
+        while (s < slotCount && triangles < targetTriangles){
+            triangles += trianglesIn(s++);
+        }
+        runEnds.push_back(s);
+    }
+}
+
+void MeshClusters::split(MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces)
+{
+    clusters.clear();
+    cut(faces.size(), [&](int s){
+        return buffers.firstTriangle(s + 1) - buffers.firstTriangle(s);
+    });
+    int s = 0;
+    for (int end : runEnds){
+        Cluster c;
+        c.firstSlot = s;
+        c.endSlot = end;
+        c.firstTriangle = buffers.firstTriangle(s);
+        c.triangleCount = buffers.firstTriangle(end) - c.firstTriangle;
+        fit(c, buffers, faces);
+        clusters.push_back(c);
+        s = end;
+    }
+}
+
+void MeshClusters::fit(Cluster &c, MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces)
+{
+    c.boxMin = glm::vec3(std::numeric_limits<float>::max());
+    c.boxMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int s = c.firstSlot; s < c.endSlot; s++){
+        HalfEdge *first = buffers.faceAt(faces, s)->edge;
+        HalfEdge *e = first;
+        do {
+            c.boxMin = glm::min(c.boxMin, e->vert->pos);
+            c.boxMax = glm::max(c.boxMax, e->vert->pos);
+            e = e->next;
+        } while (e != first);
+    }
+    c.centre = 0.5f * (c.boxMin + c.boxMax);
+    c.radius = 0.5f * glm::length(c.boxMax - c.boxMin);
+}
+
+int MeshClusters::clusterOf(int s)
+{
+    auto after = std::upper_bound(clusters.begin(), clusters.end(), s,
+                                  [](int slot, const Cluster &c){ return slot < c.firstSlot; });
+    return int(after - clusters.begin()) - 1;
+}
+
+void MeshClusters::refit(MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces, std::vector<int> &changed)
+{
+    std::vector<int> touched;
+    for (int s : changed){
+        int c = clusterOf(s);
+        if (c >= 0){
+            touched.push_back(c);
+        }
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    for (int c : touched){
+        fit(clusters[c], buffers, faces);
+    }
+}
+
+int MeshClusters::cull(const glm::mat4 &viewProj, std::vector<std::pair<int, int>> &ranges)
+{
+    Frustum frustum(viewProj);
+    ranges.clear();
+    int visible = 0;
+    for (const Cluster &c : clusters){
+        // The sphere rejects most clusters more cheaply, and the box the ones
+        // near the frustum's corners
+        if (!frustum.intersects(c.centre, c.radius) || !frustum.intersects(c.boxMin, c.boxMax)){
+            continue;
+        }
+        visible++;
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == c.firstTriangle){
+            ranges.back().second += c.triangleCount;
+        } else {
+            ranges.push_back(std::make_pair(c.firstTriangle, c.triangleCount));
+        }
+    }
+    return visible;
+}
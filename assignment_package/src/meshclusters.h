@@ -0,0 +1,106 @@
+#ifndef MESHCLUSTERS_H
+#define MESHCLUSTERS_H
+
+#include <la.h>
+#include <face.h>
+#include <meshbufferbuilder.h>
+#include <smartpointerhelp.h>
+#include <vector>
+#include <utility>
+#include <functional>
+
+// The six planes of a view frustum, taken from a view-projection matrix, each
+// as (normal, distance) with the normal pointing into the frustum
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum(const glm::mat4 &viewProj);
+
+    // Whether any of the sphere or box can be inside the frustum. Both are
+    // conservative: something close to a corner may pass without being seen.
+    bool intersects(const glm::vec3 &centre, float radius) const;
+    bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+};
+
+// Splits the faces of a Mesh into spatially coherent clusters of about
+// targetTriangles triangles each, so the parts of the mesh outside the view
+// can be skipped a few hundred triangles at a time. The faces are sorted
+// along a Morton curve through their centroids, and that order is handed to
+// MeshBufferBuilder::build, so every cluster is one contiguous range of the
+// index buffer.
+class MeshClusters
+{
+public:
+    struct Cluster {
+        int firstSlot;      // the build slots of its faces, [firstSlot, endSlot)
+        int endSlot;
+        int firstTriangle;  // and the triangles those cover
+        int triangleCount;
+        glm::vec3 boxMin;   // bounds of the faces' vertices
+        glm::vec3 boxMax;
+        glm::vec3 centre;   // a sphere around the box
+        float radius;
+    };
+
+    MeshClusters();
+
+    std::vector<Cluster> clusters;
+
+    // The index into the mesh's faces of every build slot, from sort()
+    std::vector<int> order;
+
+    // Roughly how many triangles go into each cluster
+    int targetTriangles;
+
+    // Number of threads the centroids are computed over; 0 uses one per hardware thread
+    int threadCount;
+
+    // The post-transform vertex cache reorder() optimizes for and acmr()
+    // simulates, as a FIFO of this many vertices. Small enough for any GPU.
+    int cacheSize;
+
+    // Orders the faces along a Morton curve, for the next build
+    void sort(std::vector<uPtr<Face>> &faces);
+
+    // Reorders the faces inside each run of order that split() turns into a
+    // cluster, so that shared vertices
+    // are used again while they're still in the vertex cache. Tipsify (Sander
+    // et al.) at face granularity: it fans around one vertex at a time,
+    // moving on to the freshest vertex that still has faces left. Only worth
+    // it for builds with shared vertices, as face corners are never reused.
+    void reorder(std::vector<uPtr<Face>> &faces);
+
+    // The average cache miss ratio, vertices transformed per triangle, of
+    // drawing the faces fan triangulated with shared vertices in the given
+    // order, or their own if it's empty
+    float acmr(std::vector<uPtr<Face>> &faces, const std::vector<int> &order);
+
+    // Cuts the slots of a build made with order into clusters and computes
+    // their bounds
+    void split(MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces);
+
+    // Recomputes the bounds of the clusters holding the given slots, after
+    // their vertices moved
+    void refit(MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces, std::vector<int> &changed);
+
+    // Replaces ranges with the (first triangle, triangle count) ranges of the
+    // clusters that may be visible, with neighbouring ones merged into one
+    // range. Returns the number of visible clusters.
+    int cull(const glm::mat4 &viewProj, std::vector<std::pair<int, int>> &ranges);
+
+private:
+    // The slot every cluster ends at, from the last cut()
+    std::vector<int> runEnds;
+
+    // Cuts slots [0, slotCount) into runs of about targetTriangles triangles,
+    // given the triangles of every slot. reorder() only moves faces within
+    // these runs and split() makes one cluster of each, so both cut here.
+    void cut(int slotCount, const std::function<int(int)> &trianglesIn);
+
+    // Returns the cluster holding slot s
+    int clusterOf(int s);
+
+    void fit(Cluster &c, MeshBufferBuilder &buffers, std::vector<uPtr<Face>> &faces);
+};
+
+#endif // MESHCLUSTERS_H
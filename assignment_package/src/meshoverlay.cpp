@@ -0,0 +1,120 @@
+#include "meshoverlay.h"
+#include <algorithm>
+
+MeshOverlay::MeshOverlay(OpenGLContext *context, Mesh *mesh, Kind kind)
+    : Drawable(context),
+      colour(packColour(kind == VERTICES ? glm::vec3(1.f) : glm::vec3(0.f))),
+      highlightColour(packColour(kind == VERTICES ? glm::vec3(1.f, 0.f, 0.f) : glm::vec3(1.f, 1.f, 0.f))),
+      mesh(mesh), kind(kind), element(), highlighted(-1)
+{}
+
+void MeshOverlay::create()
+{
+    MeshBufferBuilder &buffers = mesh->buffers;
+    bool shared = buffers.mode == MeshBufferBuilder::SHARED_VERTICES;
+    std::vector<GLuint> idx;
+    element.clear();
+    highlighted = -1;
+
+    int faceCount = mesh->faces.size();
+    for (int f = 0; f < faceCount; f++){
+        Face *face = buffers.faceAt(mesh->faces, f);
+        int first = buffers.firstCorner(f);
+        int n = buffers.firstCorner(f + 1) - first;
+
+        // Corner i of the face is where its i-th half edge ends, so half
+        // edge i runs from corner i - 1 to corner i
+        HalfEdge *e = face->edge;
+        HalfEdge *prev = e;
+        while (prev->next != e){
+            prev = prev->next;
+        }
+        for (int i = 0; i < n; prev = e, e = e->next, i++){
+            GLuint corner = shared ? GLuint(buffers.vertexIndex(mesh->vertices, e->vert)) : GLuint(first + i);
+            if (kind == VERTICES){
+                if (e->vert->iD >= element.size()){
+                    element.resize(e->vert->iD + 1, -1);
+                }
+                if (element[e->vert->iD] < 0){
+                    element[e->vert->iD] = idx.size();
+                    idx.push_back(corner);
+                }
+                continue;
+            }
+
+            // Inner edges are drawn from the half edge with the lower iD, and
+            // boundary edges from the one that has a face
+            HalfEdge *sym = e->sym;
+            if (sym && sym->face && sym->iD < e->iD){
+                continue;
+            }
+            GLuint from = shared ? GLuint(buffers.vertexIndex(mesh->vertices, prev->vert))
+                                 : GLuint(first + (i == 0 ? n - 1 : i - 1));
+            unsigned int last = std::max(e->iD, sym ? sym->iD : 0u);
+            if (last >= element.size()){
+                element.resize(last + 1, -1);
+            }
+            element[e->iD] = idx.size() / 2;
+            if (sym){
+                element[sym->iD] = idx.size() / 2;
+            }
+            idx.push_back(from);
+            idx.push_back(corner);
+        }
+    }
+
+    count = idx.size();
+
+    generateIdx();
+    mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufIdx);
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint), idx.data(), GL_STATIC_DRAW);
+
+    shareVert(*mesh);
+
+    std::vector<GLuint> cols(kind == VERTICES ? idx.size() : idx.size() / 2, colour);
+    generateFaceCol();
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, bufFaceCol);
+    mp_context->glBufferData(GL_TEXTURE_BUFFER, cols.size() * sizeof(GLuint), cols.data(), GL_DYNAMIC_DRAW);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, texFaceCol);
+    mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8, bufFaceCol);
+}
+
+GLenum MeshOverlay::drawMode()
+{
+    return kind == VERTICES ? GL_POINTS : GL_LINES;
+}
+
+void MeshOverlay::highlight(Vertex *v)
+{
+    setHighlight(kind == VERTICES && v && v->iD < element.size() ? element[v->iD] : -1);
+}
+
+void MeshOverlay::highlight(HalfEdge *e)
+{
+    setHighlight(kind == EDGES && e && e->iD < element.size() ? element[e->iD] : -1);
+}
+
+void MeshOverlay::setHighlight(int i)
+{
+    if (i == highlighted){
+        return;
+    }
+    int previous = highlighted;
+    highlighted = i;
+    if (previous >= 0){
+        recolour(previous);
+    }
+    if (i >= 0){
+        recolour(i);
+    }
+}
+
+void MeshOverlay::recolour(int i)
+{
+    if (!faceColBound){
+        return;
+    }
+    GLuint c = i == highlighted ? highlightColour : colour;
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, bufFaceCol);
+    mp_context->glBufferSubData(GL_TEXTURE_BUFFER, i * sizeof(GLuint), sizeof(GLuint), &c);
+}
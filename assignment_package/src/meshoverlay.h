@@ -0,0 +1,61 @@
+#ifndef MESHOVERLAY_H
+#define MESHOVERLAY_H
+
+#include <drawable.h>
+#include <mesh.h>
+#include <vector>
+
+// Every vertex of a Mesh as a point, or every edge as a line, drawn in one
+// call straight from the mesh's own vertex buffer (see Drawable::shareVert)
+// with an index buffer of its own. The colour of each point or line is a
+// texel of the face colour buffer texture, read at gl_PrimitiveID like the
+// triangles of a shared vertex mesh, so highlighting the selected element
+// rewrites two texels instead of rebuilding anything.
+//
+// The indices are built from the mesh's last MeshBufferBuilder build, for
+// either layout: a vertex is its one slot with SHARED_VERTICES and one of its
+// corners with FACE_CORNERS, and an edge runs between the corners of one of
+// the faces on either side of it. Edits that move vertices show up without
+// any work here, but the overlay has to be created again whenever the mesh
+// is.
+class MeshOverlay : public Drawable
+{
+public:
+    enum Kind {
+        VERTICES, // a GL_POINTS point per vertex
+        EDGES     // a GL_LINES line per edge, whichever of its half edges is asked for
+    };
+
+    MeshOverlay(OpenGLContext *context, Mesh *mesh, Kind kind);
+
+    void create() override;
+
+    // GL_POINTS or GL_LINES, by kind
+    GLenum drawMode() override;
+
+    // Highlights the point of v or the line of e, putting back the colour of
+    // the one highlighted before. nullptr, or an element the overlay doesn't
+    // show, clears the highlight.
+    void highlight(Vertex *v);
+    void highlight(HalfEdge *e);
+
+    // The colours elements are drawn in, and the one highlighted
+    GLuint colour;
+    GLuint highlightColour;
+
+private:
+    Mesh *mesh;
+    Kind kind;
+
+    // The point or line of every vertex or half edge by iD, or -1
+    std::vector<int> element;
+
+    int highlighted; // the element drawn in highlightColour, or -1
+
+    void setHighlight(int i);
+
+    // Uploads the colour of element i
+    void recolour(int i);
+};
+
+#endif // MESHOVERLAY_H
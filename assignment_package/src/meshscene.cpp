@@ -0,0 +1,168 @@
+#include "meshscene.h"
+
+MeshInstances::MeshInstances(OpenGLContext *context, Mesh *mesh)
+    : Drawable(context), mesh(mesh), texels(), changed(false)
+{}
+
+void MeshInstances::create()
+{
+    shareGeometry(*mesh);
+    instances = size();
+
+    generateInst();
+    mp_context->glBindBuffer(GL_TEXTURE_BUFFER, bufInst);
+    mp_context->glBufferData(GL_TEXTURE_BUFFER, texels.size() * sizeof(glm::vec4), texels.data(), GL_STATIC_DRAW);
+    mp_context->glBindTexture(GL_TEXTURE_BUFFER, texInst);
+    mp_context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bufInst);
+    changed = false;
+}
+
+void MeshInstances::add(const glm::mat4 &transform, const glm::vec4 &tint)
+{
+    for (int c = 0; c < 4; c++){
+        texels.push_back(transform[c]);
+    }
+    texels.push_back(tint);
+    changed = true;
+}
+
+int MeshInstances::size() const
+{
+    return texels.size() / 5;
+}
+
+MeshScene::MeshScene(OpenGLContext *context, BufferUploader *uploader)
+    : context(context), uploader(uploader), meshes(), batches(), loads(), cancelled()
+{}
+
+int MeshScene::addMesh(uPtr<Mesh> mesh)
+{
+    batches.push_back(mkU<MeshInstances>(context, mesh.get()));
+    meshes.push_back(std::move(mesh));
+    return meshes.size() - 1;
+}
+
+void MeshScene::addInstance(int mesh, const glm::mat4 &transform, const glm::vec4 &tint)
+{
+    batches[mesh]->add(transform, tint);
+}
+
+void MeshScene::load(const std::string &fileName, Placement place)
+{
+    uPtr<Mesh> mesh = mkU<Mesh>(context);
+    mesh->loadAsync(*uploader, fileName);
+    loads.push_back({std::move(mesh), place});
+}
+
+bool MeshScene::loading() const
+{
+    return !loads.empty() || !cancelled.empty();
+}
+
+Mesh &MeshScene::mesh(int mesh)
+{
+    return *meshes[mesh];
+}
+
+void MeshScene::clear()
+{
+    destroy();
+    batches.clear();
+    meshes.clear();
+}
+
+bool MeshScene::create()
+{
+    dropCancelled();
+    for (size_t i = 0; i < loads.size();){
+        if (!loads[i].mesh->swapPending()){
+            i++;
+            continue;
+        }
+        Load load = std::move(loads[i]);
+        loads.erase(loads.begin() + i);
+        int m = addMesh(std::move(load.mesh));
+        load.place(*this, m);
+    }
+
+    bool uploaded = false;
+    for (size_t i = 0; i < meshes.size(); i++){
+        // A mesh's count stays -1 until its first create()
+        if (meshes[i]->elemCount() < 0){
+            meshes[i]->create();
+            batches[i]->changed = true;
+        }
+        if (batches[i]->changed){
+            batches[i]->destroy();
+            batches[i]->create();
+            uploaded = true;
+        }
+    }
+    return uploaded;
+}
+
+void MeshScene::draw(ShaderVariants &shaders, const glm::mat4 &model, int features)
+{
+    for (uPtr<MeshInstances> &batch : batches){
+        if (batch->instanceCount() > 0){
+            shaders.draw(*batch, model, features);
+        }
+    }
+}
+
+int MeshScene::meshCount() const
+{
+    return meshes.size();
+}
+
+int MeshScene::instanceCount() const
+{
+    int n = 0;
+    for (const uPtr<MeshInstances> &batch : batches){
+        n += batch->size();
+    }
+    return n;
+}
+
+size_t MeshScene::geometryBytes() const
+{
+    size_t bytes = 0;
+    for (const uPtr<Mesh> &m : meshes){
+        const MeshBufferBuilder &b = m->buffers;
+        bytes += b.verts.size() + (b.idx.size() + b.faceCols.size()) * sizeof(GLuint);
+    }
+    return bytes;
+}
+
+size_t MeshScene::instanceBytes() const
+{
+    return instanceCount() * 5 * sizeof(glm::vec4);
+}
+
+void MeshScene::destroy()
+{
+    for (uPtr<MeshInstances> &batch : batches){
+        batch->destroy();
+    }
+    for (uPtr<Mesh> &mesh : meshes){
+        mesh->destroy();
+    }
+    for (Load &load : loads){
+        if (!load.mesh->dropPending()){
+            cancelled.push_back(std::move(load.mesh));
+        }
+    }
+    loads.clear();
+    dropCancelled();
+}
+
+void MeshScene::dropCancelled()
+{
+    for (size_t i = 0; i < cancelled.size();){
+        if (cancelled[i]->dropPending()){
+            cancelled.erase(cancelled.begin() + i);
+        } else {
+            i++;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef MESHSCENE_H
+#define MESHSCENE_H
+
+#include <bufferuploader.h>
+#include <drawable.h>
+#include <mesh.h>
+#include <shadervariants.h>
+#include <smartpointerhelp.h>
+#include <functional>
+#include <vector>
+
+// Every copy of one Mesh, drawn in one instanced call straight from the
+// mesh's own buffers (see Drawable::shareGeometry). Each instance is five
+// texels of texInst, laid out as mesh.vert.glsl's u_Instances expects: the
+// columns of its transform and the colour it's tinted towards by the
+// colour's alpha.
+class MeshInstances : public Drawable
+{
+private:
+    Mesh *mesh;
+    std::vector<glm::vec4> texels;
+
+public:
+    MeshInstances(OpenGLContext *context, Mesh *mesh);
+
+    // Shares the mesh's geometry, which has to be created first, and uploads
+    // the instances
+    void create() override;
+
+    void add(const glm::mat4 &transform, const glm::vec4 &tint);
+    int size() const;
+
+    // Whether instances were added since the last create()
+    bool changed;
+};
+
+// Meshes laid out any number of times each, such as a herd of cows. Every
+// mesh is kept once, on the CPU and the GPU alike, and its copies only add
+// their instance texels, so the memory goes with the geometry rather than
+// the number of instances. Drawing takes one call per mesh.
+class MeshScene
+{
+public:
+    // Lays out the copies of a mesh that just finished loading, given the
+    // index to add them under
+    typedef std::function<void(MeshScene &, int)> Placement;
+
+private:
+    OpenGLContext *context;
+    BufferUploader *uploader;
+
+    // The meshes and their instances, at the same indices
+    std::vector<uPtr<Mesh>> meshes;
+    std::vector<uPtr<MeshInstances>> batches;
+
+    // Meshes still loading on uploader's thread, each with how to place it
+    struct Load {
+        uPtr<Mesh> mesh;
+        Placement place;
+    };
+    std::vector<Load> loads;
+
+    // Meshes of loads dropped while their upload was still running, kept
+    // until it has run so its buffers can be deleted
+    std::vector<uPtr<Mesh>> cancelled;
+
+    // Deletes the cancelled meshes whose uploads have run
+    void dropCancelled();
+
+public:
+    MeshScene(OpenGLContext *context, BufferUploader *uploader);
+
+    // Takes a mesh to lay out copies of, and returns the index to add them
+    // under. Its buffers are made by the next create().
+    int addMesh(uPtr<Mesh> mesh);
+
+    // Places a copy of the given mesh, transformed before the model matrix
+    // it's drawn with and optionally tinted
+    void addInstance(int mesh, const glm::mat4 &transform, const glm::vec4 &tint = glm::vec4(0.f));
+
+    // Loads an .obj file in the background (see Mesh::loadAsync). The scene
+    // is drawn as it is meanwhile, and the first create() after the mesh's
+    // buffers are complete adds it and calls place.
+    void load(const std::string &fileName, Placement place);
+    // Whether a load is still waiting for its buffers, or a cancelled one
+    // still has to be cleaned up after
+    bool loading() const;
+
+    Mesh &mesh(int mesh);
+
+    // Drops every mesh and instance, and cancels any loads in progress
+    // without waiting for them. Needs a current context.
+    void clear();
+
+    // Adds the loaded meshes whose buffers are complete, creates the buffers
+    // of the meshes added since the last call, and uploads the instances of
+    // those that changed. Returns whether anything was uploaded.
+    bool create();
+
+    // Draws the instances of every mesh with the shader variant for them
+    void draw(ShaderVariants &shaders, const glm::mat4 &model, int features);
+
+    int meshCount() const;
+    int instanceCount() const;
+
+    // Bytes uploaded for the meshes' vertices, indices and triangle colours,
+    // and for the instances' transforms and colours
+    size_t geometryBytes() const;
+    size_t instanceBytes() const;
+
+    // Also cancels the loads in progress, whose meshes can't be drawn without
+    // the buffers. Their uploads are cleaned up by the next create() or
+    // destroy() that finds them done.
+    void destroy();
+};
+
+#endif // MESHSCENE_H
@@ -9,28 +9,57 @@
 #include <halfedgedisplay.h>
 #include <smartpointerhelp.h>
 #include <unordered_set>
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <vertex.h>
+#include <QElapsedTimer>
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_geomSquare(this),
-      m_progLambert(this), m_progFlat(this),
-      m_progSkeleton(this), m_mesh(Mesh(this)),
-      m_skeleton(Joint(this)),
+      m_shaders(this), m_uploader(this), m_mesh(Mesh(this)), m_scene(this, &m_uploader),
+      m_skeleton(Joint(this)), m_jointGizmos(this), m_jointLinks(this), m_palette(this), m_frame(this),
+      dirty(0), refreshRequests(0), refreshesRun(0), refreshesCoalesced(0), framesSkipped(0),
+      frameNanos(0), framesTimed(0), stateCallsTimed(0), stateSkipsTimed(0),
+      clustersTimed(0), framesCulled(0),
+      m_gpuTimer(), gpuTimerPending(false), gpuNanos(0), gpuFramesTimed(0), m_antiAliasing(this), m_adaptive(this), m_lods(this),
       m_glCamera(), selected(nullptr),
       m_mousePosPrev(), vertDisp(this),
-      faceDisp(this), edgeDisp(this), meshBound(false)
+      faceDisp(this), edgeDisp(this),
+      m_vertOverlay(this, &m_mesh, MeshOverlay::VERTICES), m_edgeOverlay(this, &m_mesh, MeshOverlay::EDGES),
+      vertexOverlay(false), wireframeOverlay(false), overlaysBuilt(true), meshBound(false),
+      adaptiveMode(false), lodMode(false)
 
 {
     setFocusPolicy(Qt::StrongFocus);
+
+    // Test images are compared pixel by pixel, so they're drawn as they are
+    if (autotesting){
+        m_antiAliasing.mode = AntiAliasing::NONE;
+    }
 }
 
 MyGL::~MyGL()
 {
     makeCurrent();
-    glDeleteVertexArrays(1, &vao);
+    // Stopping the thread drops the uploads still queued, so the ones
+    // below are all done
+    m_uploader.stop();
+    m_mesh.dropPending();
     m_geomSquare.destroy();
+    m_vertOverlay.destroy();
+    m_edgeOverlay.destroy();
     m_mesh.destroy();
+    m_scene.destroy();
+    m_adaptive.destroy();
+    m_lods.clear();
+    m_palette.destroy();
+    m_jointGizmos.destroy();
+    m_jointLinks.destroy();
+    m_frame.destroy();
+    m_antiAliasing.destroy();
+    m_gpuTimer.destroy();
     vertDisp.destroy();
     faceDisp.destroy();
     edgeDisp.destroy();
@@ -43,13 +72,11 @@ void MyGL::initializeGL()
     initializeOpenGLFunctions();
     // Print out some information about the current OpenGL context
     debugContextVersion();
+    setDebugOutput(DEBUG_OUTPUT_DEFAULT);
 
-    // Set a few settings/modes in OpenGL rendering
+    // Set a few settings/modes in OpenGL rendering. Edges are smoothed by
+    // m_antiAliasing rather than GL_POLYGON_SMOOTH and GL_LINE_SMOOTH.
     glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LINE_SMOOTH);
-    glEnable(GL_POLYGON_SMOOTH);
-    glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
-    glHint(GL_POLYGON_SMOOTH_HINT, GL_NICEST);
     // Set the size with which points should be rendered
     glPointSize(5);
     // Set the color with which the screen is filled at the start of each render call.
@@ -57,11 +84,20 @@ void MyGL::initializeGL()
 
     printGLErrorLog();
 
-    // Create a Vertex Attribute Object
-    glGenVertexArrays(1, &vao);
+    // Needs OpenGL 3.3 or ARB_timer_query
+    if (!m_gpuTimer.create()){
+        std::cerr << "No timer queries, frames are only timed on the CPU" << std::endl;
+    }
+
+    // Test images have to show every edit as soon as it's made, so the
+    // buffers are uploaded in line
+    if (!autotesting){
+        m_uploader.init();
+    }
 
     // Create a cubic structure in m_mesh
     m_mesh.createCube();
+    m_adaptive.setSource(&m_mesh);
 
     //Create the instances of Cylinder and Sphere.
     m_geomSquare.create();
@@ -76,20 +112,21 @@ void MyGL::initializeGL()
     if (meshBound){
         bindVertices();
     }
+    m_mesh.skinned = meshBound;
     m_mesh.create();
 
-    // Create and set up the diffuse shader
-    m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
-    // Create and set up the flat lighting shader
-    m_progFlat.create(":/glsl/flat.vert.glsl", ":/glsl/flat.frag.glsl");
-
-    m_progSkeleton.create(":/glsl/skeleton.vert.glsl", ":/glsl/skeleton.frag.glsl");
-
-    m_skeleton.create();
-    // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
-    // using multiple VAOs, we can just bind one once.
-    glBindVertexArray(vao);
-
+    m_jointGizmos.create();
+
+    // The shader variants the first frame draws with are built together up
+    // front, or loaded if an earlier run cached them. Any others are compiled
+    // by m_shaders as they're first drawn. The gizmos have no instances until
+    // the first frame fills them in, so their variant is named outright.
+    int features = meshBound ? Drawable::SKINNED : 0;
+    m_shaders.init();
+    m_shaders.prepare({m_shaders.features(m_mesh, features),
+                       Drawable::INSTANCED,
+                       0});
+    markDirty(DIRTY_SELECTION | DIRTY_SKELETON | DIRTY_FRAME);
     emit ctxInitialized();
 }
 
@@ -134,15 +171,14 @@ void MyGL::resizeGL(int w, int h)
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
     m_glCamera = Camera(w, h);
-    glm::mat4 viewproj = m_glCamera.getViewProj();
 
-    // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
+    // The widget's framebuffer is sized in device pixels
+    m_antiAliasing.resize(w * devicePixelRatio(), h * devicePixelRatio());
 
-    m_progLambert.setViewProjMatrix(viewproj);
-    m_progFlat.setViewProjMatrix(viewproj);
-    m_progSkeleton.setViewProjMatrix(viewproj);
+    // The view-projection matrix reaches the shaders through m_frame, which
+    // paintGL updates. The framebuffer was resized, so it has to be redrawn.
+    markDirty(DIRTY_FRAME);
 
-    printGLErrorLog();
 }
 
 Joint *MyGL::getJoint()
@@ -150,93 +186,142 @@ Joint *MyGL::getJoint()
     return &m_skeleton;
 }
 
-void MyGL::drawJointFamily(Joint *j, ShaderProgram &shader)
-{
-    shader.draw(*j);
-    for (uPtr<Joint> &child : j->children){
-        drawJointFamily(child.get(), shader);
-    }
-}
-
 //This function is called by Qt any time your GL window is supposed to update
 //For example, when the function update() is called, paintGL is called implicitly.
 void MyGL::paintGL()
 {
+    // Everything edited since the last frame is rebuilt once here
+    int flushed = flush();
+
+    // The camera is uploaded once for all the programs, and only if it moved.
+    // If it didn't and nothing else changed, the widget still holds the last
+    // frame, so there's nothing to draw.
+    bool moved = m_frame.update(m_glCamera.getViewProj(), m_glCamera.eye);
+    if (!moved && (flushed & ~DIRTY_VIEW) == 0){
+        framesSkipped++;
+        return;
+    }
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    if (gpuTimerPending && m_gpuTimer.isResultAvailable()){
+        gpuNanos += m_gpuTimer.waitForResult();
+        gpuFramesTimed++;
+        gpuTimerPending = false;
+    }
+    bool gpuTimed = m_gpuTimer.isCreated() && !gpuTimerPending;
+    if (gpuTimed){
+        m_gpuTimer.begin();
+    }
+
+    // The frame is drawn offscreen and resolved into the widget's
+    // framebuffer at the end
+    m_antiAliasing.begin();
+
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    std::vector<Joint*> skeleton;
-    retrieveJoints(&m_skeleton, skeleton);
+    resetStateStats();
 
-    std::vector<glm::mat4> bindMats;
-    std::vector<glm::mat4> transMats;
-
-    // Sets the bind matrices if and only if the mesh is bound to the skeleton
     if (meshBound){
-        for (Joint *jnt : skeleton){
-            glm::mat4 bind = jnt->bind;
-            glm::mat4 trans = jnt->getOverallTransformation();
-            bindMats.push_back(bind);
-            transMats.push_back(trans);
-            glm::mat4 prod = bind * trans;
-            prod = bind * trans;
-        }
-        m_progSkeleton.setBindMatrix(bindMats);
-        m_progSkeleton.setTransMatrix(transMats);
+        m_palette.bind();
     }
 
-    m_progSkeleton.setViewProjMatrix(m_glCamera.getViewProj());
-    m_progSkeleton.setModelMatrix(glm::mat4(1.f));
-
-    m_progFlat.setViewProjMatrix(m_glCamera.getViewProj());
-    m_progFlat.setBindMatrix(bindMats);
-    m_progFlat.setTransMatrix(transMats);
-    m_progLambert.setViewProjMatrix(m_glCamera.getViewProj());
-    m_progLambert.setCamPos(m_glCamera.eye);
-    m_progFlat.setModelMatrix(glm::mat4(1.f));
-
     // the model matrix is set to the identity so that we get
     // a neutral initial view
     glm::mat4 model = glm::mat4(1.0f);
 
-    // m_progSkeleton is only used if the mesh is bound to the skeleton
-    // otherwise, m_progFlat is used
+    // Each Drawable is drawn with the shader variant for the data it has, and
+    // the skinned variants are only wanted while the mesh is bound to the
+    // skeleton. Everything is flat shaded.
+    int features = meshBound ? Drawable::SKINNED : 0;
+
+    // Skinning moves the mesh away from the bounds of its clusters, so it's
+    // only culled while unbound
     if (meshBound){
-        m_progSkeleton.setModelMatrix(model);
-        m_progSkeleton.draw(m_mesh);
+        m_mesh.drawAll();
+        m_shaders.draw(m_mesh, model, features);
+    } else if (adaptiveMode){
+        // The face levels are re-evaluated for the current camera, and the
+        // patches of the faces that changed level are rewritten in place.
+        // The buffers are only rebuilt when the patches no longer fit.
+        if (m_adaptive.update(m_glCamera)){
+            m_adaptive.destroy();
+            m_adaptive.create();
+        }
+        m_shaders.draw(m_adaptive, model, features);
+    } else if (lodMode){
+        // Falls back to m_mesh when the camera is close, no LODs were built,
+        // or they're being rebuilt after a topology change, in which case
+        // it's drawn again until they're ready
+        LODMesh *lod = m_lods.select(m_glCamera);
+        if (m_lods.rebuilding()){
+            update();
+        }
+        if (lod){
+            m_shaders.draw(*lod, model, features);
+        } else {
+            cullMesh();
+            m_shaders.draw(m_mesh, model, features);
+        }
     } else {
-        m_progFlat.setModelMatrix(model);
-        m_progFlat.draw(m_mesh);
+        cullMesh();
+        m_shaders.draw(m_mesh, model, features);
+    }
+
+    // The herds are never skinned or subdivided, whatever m_mesh is drawn with
+    m_scene.draw(m_shaders, model, 0);
+
+    // The overlays show every vertex and edge, including the ones behind
+    // the mesh, so they're drawn without the depth check
+    if ((vertexOverlay || wireframeOverlay) && overlaysBuilt){
+        glDisable(GL_DEPTH_TEST);
+        if (wireframeOverlay){
+            m_shaders.draw(m_edgeOverlay, model, features);
+        }
+        if (vertexOverlay){
+            m_shaders.draw(m_vertOverlay, model, features);
+        }
+        glEnable(GL_DEPTH_TEST);
     }
 
     // if selected isn't null, it's rendered, and the depth check
     // is overriden in order to render the component in front of
-    // the mesh
-    if (selected != nullptr){
+    // the mesh. Selected joints are tinted by the gizmos instead.
+    if (selected != nullptr && dynamic_cast<Joint*>(selected) == nullptr){
         glDisable(GL_DEPTH_TEST);
-        model = glm::mat4(1.0f);
-
-        // m_progSkeleton is only used if the mesh is bound to the skeleton
-        // otherwise, m_progFlat is used
-        if (meshBound){
-            m_progSkeleton.setModelMatrix(model);
-            m_progSkeleton.draw(*selected);
-        } else {
-            m_progFlat.setModelMatrix(model);
-            m_progFlat.draw(*selected);
-        }
+        m_shaders.draw(*selected, model, features);
         glEnable(GL_DEPTH_TEST);
     }
 
 
     glDisable(GL_DEPTH_TEST);
-    model = glm::mat4(1.0f);
 
-    // m_progFlat is used for the joints so as to not disfigure the shape
-    // of the joint pointers
-    m_progFlat.setModelMatrix(model);
-    drawJointFamily(&m_skeleton, m_progFlat);
+    // the joints are never skinned, so as to not disfigure the shape
+    // of the joint pointers. The whole skeleton takes two draws.
+    m_shaders.draw(m_jointGizmos, model, 0);
+    m_shaders.draw(m_jointLinks, model, 0);
     glEnable(GL_DEPTH_TEST);
+
+    m_antiAliasing.end(defaultFramebufferObject());
+
+    if (gpuTimed){
+        m_gpuTimer.end();
+        gpuTimerPending = true;
+    }
+    frameNanos += frameTimer.nsecsElapsed();
+    framesTimed++;
+
+    // The shader programs skip binds and uniform uploads that wouldn't change
+    // anything; reported with the frame time
+    stateCallsTimed += stateCallsIssued;
+    stateSkipsTimed += stateCallsSkipped;
+}
+
+void MyGL::cullMesh()
+{
+    clustersTimed += m_mesh.cull(m_glCamera.getViewProj());
+    framesCulled++;
 }
 
 void MyGL::selectVert(QListWidgetItem *comp)
@@ -248,7 +333,7 @@ void MyGL::selectVert(QListWidgetItem *comp)
         j->selected = false;
     }
     selected = &vertDisp;
-    refreshMesh();
+    refreshSelection();
 }
 
 void MyGL::selectFace(QListWidgetItem *comp)
@@ -260,7 +345,7 @@ void MyGL::selectFace(QListWidgetItem *comp)
         j->selected = false;
     }
     selected = &faceDisp;
-    refreshMesh();
+    refreshSelection();
 }
 
 void MyGL::selectEdge(QListWidgetItem *comp)
@@ -272,7 +357,7 @@ void MyGL::selectEdge(QListWidgetItem *comp)
         j->selected = false;
     }
     selected = &edgeDisp;
-    refreshMesh();
+    refreshSelection();
 }
 
 void MyGL::selectJoint(QTreeWidgetItem *comp)
@@ -293,10 +378,11 @@ void MyGL::setSelectedX(double val)
     VertexDisplay *currV = dynamic_cast<VertexDisplay*>(selected);
     if (currJ){
         currJ->pos[0] = val;
+        refreshSkeleton();
     } else if (currV){
         currV->getSource()->pos[0] = val;
+        refreshVertex(currV->getSource());
     }
-    refreshMesh();
 }
 
 void MyGL::setSelectedY(double val)
@@ -305,10 +391,11 @@ void MyGL::setSelectedY(double val)
     VertexDisplay *currV = dynamic_cast<VertexDisplay*>(selected);
     if (currJ){
         currJ->pos[1] = val;
+        refreshSkeleton();
     } else if (currV){
         currV->getSource()->pos[1] = val;
+        refreshVertex(currV->getSource());
     }
-    refreshMesh();
 }
 
 void MyGL::setSelectedZ(double val)
@@ -317,10 +404,11 @@ void MyGL::setSelectedZ(double val)
     VertexDisplay *currV = dynamic_cast<VertexDisplay*>(selected);
     if (currJ){
         currJ->pos[2] = val;
+        refreshSkeleton();
     } else if (currV){
         currV->getSource()->pos[2] = val;
+        refreshVertex(currV->getSource());
     }
-    refreshMesh();
 }
 
 // Set the influence of a joint on a vertex to val, and the other
@@ -329,7 +417,7 @@ void MyGL::setInfluence(Vertex *v, double val, int idx)
 {
     v->influence[idx] = val;
     v->influence[(idx + 1) % 2]  = 1 - val;
-    refreshMesh();
+    refreshVertex(v);
 }
 
 // Add a vertex in the middle of the selected HalfEdge
@@ -337,39 +425,69 @@ void MyGL::addVertex(QListWidgetItem *selected)
 {
     // The operation is only performed if the halfEdge is selected
     if (selected == edgeDisp.getSource() && this->selected == &edgeDisp){
-        HalfEdge *e1 = dynamic_cast<HalfEdge*>(selected);
-        HalfEdge *e2 = e1->sym;
-        m_mesh.vertices.push_back(mkU<Vertex>());
-        m_mesh.halfEdges.push_back(mkU<HalfEdge>());
-        HalfEdge *e1b = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
-        Vertex *v = m_mesh.vertPtr(m_mesh.vertices.size() - 1);
+        splitEdge(dynamic_cast<HalfEdge*>(selected));
+
+        // after the operation is over, the QListWidget is re-initialized
+        // and the scene refreshed
+        emit ctxInitialized();
+        refreshMesh();
+    }
+}
+
+// Splits e1 and its sym with a new vertex at their midpoint. An edge with
+// no sym is split on e1's side only.
+Vertex *MyGL::splitEdge(HalfEdge *e1)
+{
+    HalfEdge *e2 = e1->sym;
+    m_mesh.vertices.push_back(mkU<Vertex>());
+    m_mesh.halfEdges.push_back(mkU<HalfEdge>());
+    HalfEdge *e1b = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
+    Vertex *v = m_mesh.vertPtr(m_mesh.vertices.size() - 1);
+    e1b->vert = e1->vert;
+    e1->vert->edge = e1b;
+    e1->vert = v;
+    e1b->face = e1->face;
+    e1b->next = e1->next;
+    e1->next = e1b;
+    e1b->sym = nullptr;
+    e1->sym = nullptr;
+
+    // The old ends of the edge point to the half edges still ending there.
+    // The other end is where e1 starts, e2's head or, without e2, the head
+    // of the half edge before e1.
+    glm::vec3 otherEnd;
+    if (e2){
         m_mesh.halfEdges.push_back(mkU<HalfEdge>());
         HalfEdge *e2b = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
-        e1b->vert = e1->vert;
-        e1->vert->edge = e1b;
         e2b->vert = e2->vert;
-        e1->vert = v;
+        e2->vert->edge = e2b;
         e2->vert = v;
-        e1b->face = e1->face;
         e2b->face = e2->face;
-        e1b->next = e1->next;
         e2b->next = e2->next;
-        e1->next = e1b;
         e2->next = e2b;
         e1b->sym = e2;
         e2->sym = e1b;
         e2b->sym = e1;
         e1->sym = e2b;
-        e2->face->edge = e2;
-        e1->face->edge = e1;
-        v->pos = glm::vec3((e1b->vert->pos + e2b->vert->pos) * 0.5f);
-        v->edge = e1;
+        otherEnd = e2b->vert->pos;
 
-        // after the operation is over, the QListWidget is re-initialized
-        // and the scene refreshed
-        emit ctxInitialized();
-        refreshMesh();
+        // Boundary half edges left over from the .obj have no face
+        if (e2->face){
+            e2->face->edge = e2;
+        }
+    } else {
+        HalfEdge *prev = e1b;
+        while (prev->next != e1){
+            prev = prev->next;
+        }
+        otherEnd = prev->vert->pos;
+    }
+    if (e1->face){
+        e1->face->edge = e1;
     }
+    v->pos = glm::vec3((e1b->vert->pos + otherEnd) * 0.5f);
+    v->edge = e1;
+    return v;
 }
 
 // Noise functio to give pseudorandom colours to new faces created
@@ -392,32 +510,7 @@ void MyGL::triangulate(QListWidgetItem *selected)
         if (pivot->next->next->next == pivot){
             return;
         }
-        do {
-            m_mesh.faces.push_back(mkU<Face>());
-            Face *fPtr = m_mesh.facePtr(m_mesh.faces.size() - 1);
-            m_mesh.halfEdges.push_back(mkU<HalfEdge>());
-            HalfEdge *e0 = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
-            m_mesh.halfEdges.push_back(mkU<HalfEdge>());
-            HalfEdge *e1 = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
-            e0->sym = e1;
-            e1->sym = e0;
-            e0->next = pivot->next;
-            e0->vert = pivot->vert;
-            e1->next = pivot->next->next->next;
-            pivot->next->next->next = e0;
-            e1->vert = pivot->next->next->vert;
-            pivot->next->face = fPtr;
-            pivot->next->next->face = fPtr;
-            e0->face = fPtr;
-            fPtr->edge = e0;
-            e1->face = pivot->face;
-            pivot->next = e1;
-            if ((noise3D(glm::vec2(fPtr->iD, glm::sin(m_mesh.vertices.size() * 7.64)))) > 0.25){
-                fPtr->colour = f->colour * noise3D(glm::vec2(fPtr->iD, m_mesh.halfEdges.size()));
-            } else {
-                fPtr->colour = f->colour / noise3D(glm::vec2(fPtr->iD, m_mesh.halfEdges.size()));
-            }
-        } while (pivot->next->next->next != pivot);
+        triangulateFace(f);
 
         // after the operation is over, the QListWidget is re-initialized
         // and the scene refreshed
@@ -426,6 +519,241 @@ void MyGL::triangulate(QListWidgetItem *selected)
     }
 }
 
+// Fans out f from its first edge, creating a new face for every triangle
+// but the last one, which stays in f
+void MyGL::triangulateFace(Face *f)
+{
+    HalfEdge *pivot = f->edge;
+    while (pivot->next->next->next != pivot){
+        m_mesh.faces.push_back(mkU<Face>());
+        Face *fPtr = m_mesh.facePtr(m_mesh.faces.size() - 1);
+        m_mesh.halfEdges.push_back(mkU<HalfEdge>());
+        HalfEdge *e0 = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
+        m_mesh.halfEdges.push_back(mkU<HalfEdge>());
+        HalfEdge *e1 = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
+        e0->sym = e1;
+        e1->sym = e0;
+        e0->next = pivot->next;
+        e0->vert = pivot->vert;
+        e1->next = pivot->next->next->next;
+        pivot->next->next->next = e0;
+        e1->vert = pivot->next->next->vert;
+        pivot->next->face = fPtr;
+        pivot->next->next->face = fPtr;
+        e0->face = fPtr;
+        fPtr->edge = e0;
+        e1->face = pivot->face;
+        pivot->next = e1;
+        if ((noise3D(glm::vec2(fPtr->iD, glm::sin(m_mesh.vertices.size() * 7.64)))) > 0.25){
+            fPtr->colour = f->colour * noise3D(glm::vec2(fPtr->iD, m_mesh.halfEdges.size()));
+        } else {
+            fPtr->colour = f->colour / noise3D(glm::vec2(fPtr->iD, m_mesh.halfEdges.size()));
+        }
+    }
+}
+
+// Triangulates every face with more than three vertices. New faces are
+// appended to the mesh, so only the faces that existed beforehand are visited.
+void MyGL::triangulateAll()
+{
+    int faceCount = m_mesh.faces.size();
+    for (int i = 0; i < faceCount; i++){
+        Face *f = m_mesh.facePtr(i);
+        if (f->edge->next->next->next != f->edge){
+            triangulateFace(f);
+        }
+    }
+
+    resetSelection();
+    emit ctxInitialized();
+    refreshMesh();
+}
+
+void MyGL::smoothMesh(LaplacianSmoother::Weighting weighting, int iterations)
+{
+    LaplacianSmoother smoother(weighting);
+    smoother.smooth(m_mesh, iterations);
+    refreshMesh();
+}
+
+void MyGL::setVertexOverlay(bool shown)
+{
+    vertexOverlay = shown;
+    markDirty(DIRTY_OVERLAYS);
+}
+
+void MyGL::setWireframeOverlay(bool shown)
+{
+    wireframeOverlay = shown;
+    markDirty(DIRTY_OVERLAYS);
+}
+
+void MyGL::loadHerd(const std::string &fileName, int rows, int columns)
+{
+    makeCurrent();
+    m_scene.load(fileName, [rows, columns](MeshScene &scene, int m){
+        // The copies are spaced by the mesh's footprint, so neighbours never overlap
+        glm::vec3 lo(std::numeric_limits<float>::max());
+        glm::vec3 hi(-std::numeric_limits<float>::max());
+        for (uPtr<Vertex> &v : scene.mesh(m).vertices){
+            lo = glm::min(lo, v->pos);
+            hi = glm::max(hi, v->pos);
+        }
+        float spacing = 1.25f * std::max(glm::length(glm::vec2(hi.x - lo.x, hi.z - lo.z)), 0.001f);
+
+        for (int r = 0; r < rows; r++){
+            for (int c = 0; c < columns; c++){
+                glm::vec3 offset((c - 0.5f * (columns - 1)) * spacing, 0.f, -(r + 1) * spacing);
+                float heading = glm::radians(47.f * (r * columns + c));
+                scene.addInstance(m, glm::rotate(glm::translate(glm::mat4(), offset), heading, glm::vec3(0, 1, 0)));
+            }
+        }
+    });
+    markDirty(DIRTY_SCENE);
+}
+
+void MyGL::clearHerds()
+{
+    makeCurrent();
+    m_scene.clear();
+    // The loads cancelled still have their uploads to clean up
+    markDirty(DIRTY_SCENE);
+    redraw();
+}
+
+void MyGL::highlightOverlays()
+{
+    m_vertOverlay.highlight(selected == &vertDisp ? vertDisp.getSource() : nullptr);
+    m_edgeOverlay.highlight(selected == &edgeDisp ? edgeDisp.getSource() : nullptr);
+}
+
+void MyGL::setDualQuatSkinning(bool dualQuat)
+{
+    m_palette.mode = dualQuat ? SkinPalette::DUAL_QUATERNIONS : SkinPalette::MATRICES;
+    m_shaders.dualQuat = dualQuat;
+    markDirty(DIRTY_SKELETON);
+}
+
+void MyGL::reportFrameTime(const std::string &setting)
+{
+    // The last frame's GPU time is waited for, so that it counts towards
+    // the setting it was drawn with
+    if (gpuTimerPending){
+        makeCurrent();
+        gpuNanos += m_gpuTimer.waitForResult();
+        gpuFramesTimed++;
+        gpuTimerPending = false;
+    }
+    if (framesTimed > 0){
+        std::cout << "Average frame time with " << setting << ": "
+                  << frameNanos / framesTimed / 1e6 << " ms over " << framesTimed << " frames";
+        if (gpuFramesTimed > 0){
+            std::cout << ", " << gpuNanos / gpuFramesTimed / 1e6 << " ms on the GPU over "
+                      << gpuFramesTimed << " frames";
+        }
+        std::cout << std::endl;
+        std::cout << "State calls per frame: " << double(stateCallsTimed) / framesTimed << " issued, "
+                  << double(stateSkipsTimed) / framesTimed << " skipped" << std::endl;
+        std::cout << "Refreshes so far: " << refreshesRun << " rebuilds, " << refreshesCoalesced
+                  << " requests coalesced into them, " << framesSkipped << " idle frames skipped" << std::endl;
+    }
+    if (framesCulled > 0){
+        std::cout << "Mesh clusters drawn per frame: " << double(clustersTimed) / framesCulled << " of "
+                  << m_mesh.clusters.clusters.size() << std::endl;
+    }
+    if (m_scene.meshCount() > 0){
+        std::cout << "Scene: " << m_scene.instanceCount() << " instances of " << m_scene.meshCount() << " meshes, "
+                  << m_scene.geometryBytes() / 1024 << " KB of geometry and " << m_scene.instanceBytes() / 1024
+                  << " KB of instance data" << std::endl;
+    }
+    frameNanos = 0;
+    framesTimed = 0;
+    stateCallsTimed = 0;
+    stateSkipsTimed = 0;
+    clustersTimed = 0;
+    framesCulled = 0;
+    gpuNanos = 0;
+    gpuFramesTimed = 0;
+}
+
+void MyGL::setDebugOutput(bool enabled)
+{
+    reportFrameTime(std::string("GL debug output ") + (debugOutput() ? "on" : "off"));
+    OpenGLContext::setDebugOutput(enabled);
+    redraw();
+}
+
+void MyGL::setAntiAliasing(AntiAliasing::Mode mode)
+{
+    reportFrameTime(std::string("antialiasing ") + AntiAliasing::name(m_antiAliasing.mode));
+    makeCurrent();
+    m_antiAliasing.setMode(mode);
+    redraw();
+}
+
+AntiAliasing::Mode MyGL::antiAliasing() const
+{
+    return m_antiAliasing.mode;
+}
+
+void MyGL::setSharedVertices(bool shared)
+{
+    m_mesh.sharedVertices = shared;
+    refreshMesh();
+}
+
+void MyGL::buildLODs()
+{
+    m_lods.build(m_mesh);
+    redraw();
+}
+
+// Simulated on a copy of the clusters, so m_mesh's buffers are left as they are
+void MyGL::reportVertexCache()
+{
+    MeshClusters c = m_mesh.clusters;
+    c.sort(m_mesh.faces);
+    float sorted = c.acmr(m_mesh.faces, c.order);
+    c.reorder(m_mesh.faces);
+    std::cout << "Vertex cache misses per triangle: " << c.acmr(m_mesh.faces, std::vector<int>())
+              << " in creation order, " << sorted << " by cluster, "
+              << c.acmr(m_mesh.faces, c.order) << " reordered" << std::endl;
+}
+
+// Splits every edge of the mesh once
+void MyGL::splitAllEdges()
+{
+    std::vector<HalfEdge*> edges;
+    for (uPtr<HalfEdge> &e : m_mesh.halfEdges){
+        edges.push_back(e.get());
+    }
+    splitEdges(edges);
+}
+
+// Splits the given edges. A half edge and its sym describe the same edge,
+// so only the first of the two that shows up is split.
+void MyGL::splitEdges(const std::vector<HalfEdge*> &edges)
+{
+    std::unordered_set<HalfEdge*> visited;
+    std::vector<HalfEdge*> unique;
+    visited.reserve(edges.size());
+    for (HalfEdge *e : edges){
+        if (!visited.count(e->sym) && visited.insert(e).second){
+            unique.push_back(e);
+        }
+    }
+
+    // Splitting changes the syms, so the unique edges are picked out before
+    // any of them is split
+    for (HalfEdge *e : unique){
+        splitEdge(e);
+    }
+
+    resetSelection();
+    emit ctxInitialized();
+    refreshMesh();
+}
+
 // Gets the sum of adjacent midpoints to an original vertex, as well as
 // the number of adjacent faces and the sum of adjacent centroids in
 // order to help find the smoothed positions for the original vertices
@@ -452,17 +780,6 @@ std::vector<glm::vec3> MyGL::getSumVals(Vertex *v, std::vector<glm::vec3> &centr
     return sums;
 }
 
-// Checks if the given half edge pointer is in the std::vector that's
-// given
-bool contains(std::vector<HalfEdge*> container, HalfEdge* element){
-    for (HalfEdge* item : container){
-        if (item == element){
-            return true;
-        }
-    }
-    return false;
-}
-
 // Takes a face and quadrangulates it and adds the centroid as
 // a vertex
 void MyGL::quadrangulate(Face *f, glm::vec3 centroid)
@@ -515,6 +832,7 @@ void MyGL::quadrangulate(Face *f, glm::vec3 centroid)
         eFin->next = curr;
         eInit->vert = centroidV;
         eFin->vert = trailing;
+        centroidV->edge = eInit;
 
         // Setting sym values
         if (curr != ref){
@@ -539,9 +857,110 @@ void MyGL::quadrangulate(Face *f, glm::vec3 centroid)
     m_mesh.edgePtr(m_mesh.halfEdges.size() - 2)->sym = finalSym;
 }
 
-// This function does all the work needed to perform Catmull-Clark
-// subdivision
-void MyGL::catmullClark()
+// Quadrangulates a face whose N original edges have all been split, so its
+// boundary alternates between original vertices and midpoints. All the new
+// faces and half edges are known up front, so they're created together and
+// wired up through fixed-size arrays.
+template <int N>
+void MyGL::quadrangulateFixed(Face *f, glm::vec3 centroid)
+{
+    m_mesh.vertices.push_back(mkU<Vertex>());
+    Vertex *centroidV = m_mesh.vertPtr(m_mesh.vertices.size() - 1);
+    centroidV->pos = centroid;
+
+    // in[i] runs from a midpoint into original vertex i, out[i] from original
+    // vertex i to the next midpoint, and mids[i] is the midpoint before in[i]
+    std::array<HalfEdge*, N> in;
+    std::array<HalfEdge*, N> out;
+    std::array<Vertex*, N> mids;
+    HalfEdge *curr = f->edge->next;
+    Vertex *trailing = f->edge->vert;
+    for (int i = 0; i < N; i++){
+        in[i] = curr;
+        out[i] = curr->next;
+        mids[i] = trailing;
+        trailing = curr->next->vert;
+        curr = curr->next->next;
+    }
+
+    // The first quad reuses f
+    std::array<Face*, N> quads;
+    quads[0] = f;
+    for (int i = 1; i < N; i++){
+        m_mesh.faces.push_back(mkU<Face>());
+        quads[i] = m_mesh.facePtr(m_mesh.faces.size() - 1);
+    }
+
+    // toCentre[i] runs from the midpoint after vertex i to the centroid, and
+    // fromCentre[i] from the centroid back to the midpoint before vertex i
+    std::array<HalfEdge*, N> toCentre;
+    std::array<HalfEdge*, N> fromCentre;
+    for (int i = 0; i < N; i++){
+        m_mesh.halfEdges.push_back(mkU<HalfEdge>());
+        toCentre[i] = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
+        m_mesh.halfEdges.push_back(mkU<HalfEdge>());
+        fromCentre[i] = m_mesh.edgePtr(m_mesh.halfEdges.size() - 1);
+    }
+
+    glm::vec3 colour = f->colour;
+    for (int i = 0; i < N; i++){
+        Face *quad = quads[i];
+        in[i]->face = quad;
+        out[i]->face = quad;
+        toCentre[i]->face = quad;
+        fromCentre[i]->face = quad;
+        quad->edge = in[i];
+
+        out[i]->next = toCentre[i];
+        toCentre[i]->next = fromCentre[i];
+        fromCentre[i]->next = in[i];
+        toCentre[i]->vert = centroidV;
+        fromCentre[i]->vert = mids[i];
+
+        toCentre[i]->sym = fromCentre[(i + 1) % N];
+        fromCentre[(i + 1) % N]->sym = toCentre[i];
+
+        if ((noise3D(glm::vec2(quad->iD, glm::sin(m_mesh.vertices.size() * 7.64)))) > 0.4){
+            quad->colour = colour * noise3D(glm::vec2(quad->iD, m_mesh.halfEdges.size()));
+        } else {
+            quad->colour = colour / noise3D(glm::vec2(quad->iD, m_mesh.halfEdges.size()));
+        }
+    }
+    centroidV->edge = toCentre[0];
+}
+
+// Sums up the vertices of a face to get its centroid, and stores every edge of
+// the face that hasn't been seen yet (excluding syms of stored edges). With N
+// fixed the corner loop unrolls; N = 0 walks the face until it loops back.
+template <int N>
+static glm::vec3 visitFace(Face *f, std::vector<HalfEdge*> &edges, std::unordered_set<HalfEdge*> &visited)
+{
+    HalfEdge *curr = f->edge;
+    glm::vec3 centroid(0.f);
+    int n = 0;
+    auto visit = [&](){
+        if (!visited.count(curr->sym)){
+            visited.insert(curr);
+            edges.push_back(curr);
+        }
+        centroid += curr->vert->pos;
+        curr = curr->next;
+        n++;
+    };
+    if constexpr (N == 0){
+        do {
+            visit();
+        } while (curr != f->edge);
+    } else {
+        for (int i = 0; i < N; i++){
+            visit();
+        }
+    }
+    return centroid / float(n);
+}
+
+template <int N>
+void MyGL::catmullClarkStep()
 {
     // sets the number of original vertices in the mesh, so we
     // only loop at the first vertices in the mesh until we reach
@@ -549,40 +968,35 @@ void MyGL::catmullClark()
     int vertCutoff = m_mesh.vertices.size();
     std::vector<HalfEdge*> edges;
     std::vector<glm::vec3> centroids;
+    std::unordered_set<HalfEdge*> visited;
+    edges.reserve(m_mesh.halfEdges.size() / 2);
+    centroids.reserve(m_mesh.faces.size());
+    visited.reserve(m_mesh.halfEdges.size());
 
     // Looping on the faces to store the original edges (excluding their syms),
     // as well as the centroids
     for (int i = 0; i < m_mesh.faces.size(); i++){
-        Face *f = m_mesh.facePtr(i);
-        HalfEdge *curr = f->edge;
-        glm::vec3 centroid;
-        int n = 0;
-        do {
-            if (!contains(edges, curr) && !contains(edges, curr->sym)){
-                edges.push_back(curr);
-            }
-            centroid += curr->vert->pos;
-            curr = curr->next;
-            n++;
-        } while (curr != f->edge);
-        centroid /= n;
-        n = 0;
-        centroids.push_back(centroid);
-        Vertex v;
-        v.pos = centroid;
-        selectVert(&v);
+        centroids.push_back(visitFace<N>(m_mesh.facePtr(i), edges, visited));
+    }
+
+    // Every edge gets a midpoint and every face a centroid, and each corner of
+    // a face ends up as its own quad with two new half edges, so the final
+    // sizes are known before anything is created
+    int corners = 0;
+    for (uPtr<HalfEdge> &e : m_mesh.halfEdges){
+        corners += e->face != nullptr;
     }
+    m_mesh.vertices.reserve(m_mesh.vertices.size() + edges.size() + centroids.size());
+    m_mesh.halfEdges.reserve(m_mesh.halfEdges.size() + 2 * edges.size() + 2 * corners);
+    m_mesh.faces.reserve(corners);
 
 // Assigning midpoint positions
     for (HalfEdge *e : edges){
-        edgeDisp.updateHalfEdge(e);
-        selected = &edgeDisp;
         glm::vec3 midpoint = (e->vert->pos +
                               e->sym->vert->pos +
                               centroids[e->face->iD] +
                               centroids[e->sym->face->iD])/4.f;
-        addVertex(e);
-        m_mesh.vertPtr(m_mesh.vertices.size() - 1)->pos = midpoint;
+        splitEdge(e)->pos = midpoint;
     }
     selected = nullptr;
     for (int i = 0; i < vertCutoff; i++){
@@ -594,7 +1008,29 @@ void MyGL::catmullClark()
     }
     for (int i = 0; i < centroids.size(); i++){
         Face *f = m_mesh.facePtr(i);
-        quadrangulate(f, centroids[f->iD]);
+        if constexpr (N == 0){
+            quadrangulate(f, centroids[f->iD]);
+        } else {
+            quadrangulateFixed<N>(f, centroids[f->iD]);
+        }
+    }
+}
+
+// This function does all the work needed to perform Catmull-Clark
+// subdivision. Pure triangle and pure quad meshes go through the
+// fixed-size versions of the face loops.
+void MyGL::catmullClark()
+{
+    switch (m_mesh.uniformArity()){
+    case 3:
+        catmullClarkStep<3>();
+        break;
+    case 4:
+        catmullClarkStep<4>();
+        break;
+    default:
+        catmullClarkStep<0>();
+        break;
     }
     refreshMesh();
     emit ctxInitialized();
@@ -606,7 +1042,7 @@ void MyGL::rotateJoint(float angle, glm::vec3 axis)
     if (j){
         j->rotate(angle, axis);
     }
-    refreshMesh();
+    refreshSkeleton();
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e)
@@ -668,7 +1104,7 @@ void MyGL::keyPressEvent(QKeyEvent *e)
         emit halfEdgeSelected(e);
     }
     m_glCamera.RecomputeAttributes();
-    update();  // Calls paintGL, among other things
+    markDirty(DIRTY_VIEW);  // Calls paintGL, which only draws if the camera moved
 
 }
 
@@ -720,8 +1156,13 @@ void MyGL::mouseMoveEvent(QMouseEvent *e)
         m_glCamera.TranslateRight(-diff.x);
         m_glCamera.TranslateUp(diff.y);
     }
+    else
+    {
+        // Hovering doesn't move the camera
+        return;
+    }
     m_glCamera.RecomputeAttributes();
-    update();
+    markDirty(DIRTY_VIEW);
 }
 
 // Sets the position variable for the mouse when clicked in order to
@@ -752,22 +1193,208 @@ void MyGL::mousePressEvent(QMouseEvent *e)
     if (v){
         emit vertSelected(v);
     }
+    // Pressing doesn't move the camera, and a selection schedules its own repaint
     m_glCamera.RecomputeAttributes();
+}
+
+void MyGL::markDirty(int parts)
+{
+    if (parts & ~(DIRTY_VIEW | DIRTY_FRAME)){
+        refreshRequests++;
+    }
+    dirty |= parts;
     update();
 }
 
-// refreshes mygl and the mesh and the selected component
-void MyGL::refreshMesh()
+int MyGL::flush()
 {
-    m_mesh.destroy();
-    m_mesh.create();
-    m_skeleton.destroy();
-    m_skeleton.create();
-    if (selected){
+    int parts = dirty;
+    dirty = 0;
+    int rebuilds = 0;
+    int waiting = 0; // parts left dirty until an upload is done
+
+    // While m_mesh's new buffers are uploading it goes on drawing the old
+    // ones, and the edits made meanwhile, which the new buffers lack, wait
+    // to be made to them
+    bool meshRebuilt = false;
+    int held = 0;
+    if (m_mesh.pending()){
+        if (m_mesh.swapPending()){
+            meshRebuilt = true;
+            parts |= DIRTY_FRAME;
+        } else {
+            held = parts & (DIRTY_MESH | DIRTY_PATCHES);
+            parts &= ~held;
+            update();
+        }
+    }
+
+    // A full rebuild already covers any patches
+    bool rebuild = (parts & DIRTY_MESH) != 0;
+    if ((parts & DIRTY_PATCHES) && !rebuild){
+        // The same element can be patched several times between frames, but
+        // it only needs writing once
+        std::sort(dirtyVerts.begin(), dirtyVerts.end());
+        dirtyVerts.erase(std::unique(dirtyVerts.begin(), dirtyVerts.end()), dirtyVerts.end());
+        std::sort(dirtyFaces.begin(), dirtyFaces.end());
+        dirtyFaces.erase(std::unique(dirtyFaces.begin(), dirtyFaces.end()), dirtyFaces.end());
+        bool patched = true;
+        for (Vertex *v : dirtyVerts){
+            patched = patched && m_mesh.updateVertex(v);
+        }
+        for (Face *f : dirtyFaces){
+            patched = patched && m_mesh.updateFace(f);
+        }
+        rebuild = !patched;
+        rebuilds++;
+    }
+    if (rebuild){
+        m_mesh.skinned = meshBound;
+        // On the thread, the new buffers are swapped in by a later flush
+        if (m_uploader.threaded()){
+            m_mesh.createAsync(m_uploader);
+            update();
+        } else {
+            m_mesh.destroy();
+            m_mesh.create();
+            meshRebuilt = true;
+        }
+        if (parts & DIRTY_MESH){
+            rebuilds++;
+        }
+    }
+    if (parts & (DIRTY_MESH | DIRTY_PATCHES)){
+        dirtyVerts.clear();
+        dirtyFaces.clear();
+    }
+    if (meshRebuilt || (parts & (DIRTY_MESH | DIRTY_PATCHES))){
+        m_adaptive.invalidate();
+    }
+    if (parts & DIRTY_MESH){
+        m_lods.invalidate();
+    }
+
+    // The overlays read m_mesh's vertex buffer, so they follow patches by
+    // themselves but have to be built again along with it. Selecting
+    // something else only recolours two of their elements. They're built
+    // from the faces, though, so while the buffers drawn are behind the
+    // faces they wait as well, and aren't drawn at all until they're built:
+    // the buffers they were built for may be gone, and an overlay that was
+    // just switched on was never created.
+    bool overlaysStale = meshRebuilt || (parts & DIRTY_OVERLAYS);
+    if (overlaysStale && m_mesh.pending()){
+        if (meshRebuilt){
+            m_vertOverlay.destroy();
+            m_edgeOverlay.destroy();
+        }
+        overlaysBuilt = false;
+        held |= DIRTY_OVERLAYS;
+        parts &= ~DIRTY_OVERLAYS;
+        overlaysStale = false;
+    }
+    if (held){
+        dirty |= held;
+        waiting++;
+    }
+
+    if ((parts & DIRTY_SELECTION) && selected){
         selected->destroy();
         selected->create();
+        rebuilds++;
     }
-    update();
+
+    if (overlaysStale){
+        m_vertOverlay.destroy();
+        m_edgeOverlay.destroy();
+        if (vertexOverlay){
+            m_vertOverlay.create();
+        }
+        if (wireframeOverlay){
+            m_edgeOverlay.create();
+        }
+        overlaysBuilt = true;
+        if (vertexOverlay || wireframeOverlay){
+            rebuilds++;
+        }
+    }
+    if (meshRebuilt || (parts & (DIRTY_OVERLAYS | DIRTY_SELECTION))){
+        highlightOverlays();
+    }
+
+    // Herds still loading are added by whichever flush finds them done
+    if (parts & DIRTY_SCENE){
+        if (m_scene.create()){
+            rebuilds++;
+        } else {
+            parts &= ~DIRTY_SCENE;
+        }
+        if (m_scene.loading()){
+            dirty |= DIRTY_SCENE;
+            waiting++;
+            update();
+        }
+    }
+
+    // The joint matrices are only uploaded if the mesh is bound to the
+    // skeleton, and then only when one of them changed. The same goes for
+    // the joint gizmos.
+    if (parts & DIRTY_SKELETON){
+        std::vector<Joint*> skeleton;
+        std::vector<glm::mat4> overall;
+        retrieveJoints(&m_skeleton, skeleton, overall);
+        if (meshBound){
+            m_palette.update(skeleton);
+        }
+        m_jointGizmos.update(skeleton, overall);
+        m_jointLinks.update(skeleton, overall);
+        rebuilds++;
+    }
+
+    // The requests still waiting are counted by the flush that finishes them
+    int outstanding = std::min(refreshRequests, waiting);
+    refreshRequests -= outstanding;
+    refreshesRun += rebuilds;
+    if (refreshRequests > rebuilds){
+        refreshesCoalesced += refreshRequests - rebuilds;
+    }
+    refreshRequests = outstanding;
+    return parts;
+}
+
+// refreshes mygl and the mesh and the selected component
+void MyGL::refreshMesh()
+{
+    markDirty(DIRTY_MESH | DIRTY_SELECTION | DIRTY_SKELETON);
+}
+
+void MyGL::refreshVertex(Vertex *v)
+{
+    dirtyVerts.push_back(v);
+    markDirty(DIRTY_PATCHES | DIRTY_SELECTION);
+}
+
+void MyGL::refreshFace(Face *f)
+{
+    dirtyFaces.push_back(f);
+    markDirty(DIRTY_PATCHES | DIRTY_SELECTION);
+}
+
+// Joints are skinned through the palette, and the gizmos are refilled from
+// the skeleton, so moving one leaves the mesh buffers alone
+void MyGL::refreshSkeleton()
+{
+    markDirty(DIRTY_SKELETON);
+}
+
+// The gizmos tint the selected joint, so they're refilled too
+void MyGL::refreshSelection()
+{
+    markDirty(DIRTY_SELECTION | DIRTY_SKELETON);
+}
+
+void MyGL::redraw()
+{
+    markDirty(DIRTY_FRAME);
 }
 
 // Load the skeleton from a .json file
@@ -11,9 +11,22 @@
 #include <facedisplay.h>
 #include <halfedgedisplay.h>
 #include <joint.h>
+#include <adaptivesubdivision.h>
+#include <smoothing.h>
+#include <decimation.h>
+#include <skinpalette.h>
+#include <frameconstants.h>
+#include <shadervariants.h>
+#include <jointgizmos.h>
+#include <meshoverlay.h>
+#include <antialiasing.h>
+#include <meshscene.h>
+#include <bufferuploader.h>
 
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
+#include <QElapsedTimer>
+#include <QOpenGLTimerQuery>
 
 
 class MyGL
@@ -22,16 +35,66 @@ class MyGL
     Q_OBJECT
 private:
     SquarePlane m_geomSquare;// The instance of a unit cylinder we can use to render any cylinder
-    ShaderProgram m_progLambert;// A shader program that uses lambertian reflection
-    ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
-    ShaderProgram m_progSkeleton;
+    ShaderVariants m_shaders; // the mesh shader programs, one per combination of features drawn so far
+
+    BufferUploader m_uploader; // the thread m_mesh and m_scene upload new buffers on, while the old ones are drawn
 
     Mesh m_mesh; // our rendered mesh (initially a cube)
 
+    MeshScene m_scene; // copies of other meshes laid out around m_mesh, drawn instanced
+
     Joint m_skeleton;
 
-    GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
-                // Don't worry too much about this. Just know it is necessary in order to render geometry.
+    JointGizmos m_jointGizmos; // the circles around every joint of m_skeleton, drawn instanced
+    JointLinks m_jointLinks; // the lines from every joint of m_skeleton to its parent
+
+    SkinPalette m_palette; // the joint matrices the SKINNED shader variants skin m_mesh with
+
+    FrameConstants m_frame; // the camera uniforms shared by all the shader programs
+
+    int dirty; // the Dirty parts of the scene paintGL has to bring up to date
+    std::vector<Vertex*> dirtyVerts; // vertices to patch into m_mesh, for DIRTY_PATCHES
+    std::vector<Face*> dirtyFaces;   // faces to patch into m_mesh, for DIRTY_PATCHES
+
+    int refreshRequests; // markDirty() calls for rebuild work since the last flush()
+    int refreshesRun;    // rebuilds flush() actually ran, in total
+    int refreshesCoalesced; // requests that didn't need a rebuild of their own, in total
+    int framesSkipped;   // paintGL calls with nothing to draw, in total
+
+    qint64 frameNanos; // the time paintGL spent drawing since the debug output or antialiasing was last switched
+    int framesTimed;   // and the frames it drew in that time
+    qint64 stateCallsTimed;  // the GL state calls the shader programs issued in those frames
+    qint64 stateSkipsTimed;  // and the ones they skipped because nothing would change
+    qint64 clustersTimed;    // the clusters of m_mesh drawn in the timed frames that culled it
+    int framesCulled;        // and the number of those frames
+
+    // The GPU time of the same frames, where timer queries are supported.
+    // The query is read back a frame or more later, and frames drawn while
+    // it's still pending aren't timed.
+    QOpenGLTimerQuery m_gpuTimer;
+    bool gpuTimerPending;
+    qint64 gpuNanos;
+    int gpuFramesTimed;
+
+    // Prints the average frame time, state calls and clusters drawn since the last call,
+    // with what the frames were drawn with, how many refreshes were
+    // coalesced so far, and how much the herds take up. Then starts timing again.
+    void reportFrameTime(const std::string &setting);
+
+    AntiAliasing m_antiAliasing; // the offscreen framebuffer frames are drawn into and resolved from
+
+    // Limits m_mesh's next draw to its clusters in view of m_glCamera
+    void cullMesh();
+
+    // Brings every part marked dirty up to date, each once however many
+    // times it was marked. Called by paintGL before drawing, and returns the
+    // parts it flushed. Parts waiting on a background upload stay dirty,
+    // and are checked on again next frame.
+    int flush();
+
+    AdaptiveSubdivision m_adaptive; // view-dependent refinement of m_mesh, drawn instead of it in adaptive mode
+
+    LODChain m_lods; // decimated versions of m_mesh, picked by camera distance in LOD mode
 
     Camera m_glCamera;
 
@@ -43,6 +106,15 @@ private:
     FaceDisplay faceDisp; // holds a display item representing the currently selected item in ui->facesListWidget
     HalfEdgeDisplay edgeDisp; // holds a display item representing the currently selected item in ui->halfEdgesListWidget
 
+    MeshOverlay m_vertOverlay; // every vertex of m_mesh, drawn while vertexOverlay is set
+    MeshOverlay m_edgeOverlay; // every edge of m_mesh, drawn while wireframeOverlay is set
+    bool vertexOverlay;
+    bool wireframeOverlay;
+    bool overlaysBuilt; // false while the overlays wait to be built for the current faces and toggles
+
+    // Highlights the selected vertex and edge in the overlays
+    void highlightOverlays();
+
 public:
     explicit MyGL(QWidget *parent = nullptr);
     ~MyGL();
@@ -51,6 +123,10 @@ public:
     void resizeGL(int w, int h);
     void paintGL();
 
+    // Prints the average frame time with the debug output as it was, so the
+    // two can be compared, before switching it
+    void setDebugOutput(bool enabled) override;
+
     // emits the ctxInitialized signal to refresh the QListWidgets and the QTreeWidget
     void emitInit();
 
@@ -60,6 +136,15 @@ public:
     // indicates if the m_mesh is bound to m_skeleton
     bool meshBound;
 
+    // indicates if m_mesh is drawn through m_adaptive, which picks a subdivision
+    // depth per face from its size on screen. Skinned meshes are always drawn as is.
+    bool adaptiveMode;
+
+    // indicates if m_mesh is swapped for one of m_lods depending on how far away
+    // the camera is. The LODs keep up with moved vertices as they are, and are
+    // rebuilt in the background after the topology changes.
+    bool lodMode;
+
     // returns a pointer to m_mesh, used to add all the elements as QListWidgetItems to their respective QListWidget
     Mesh *getMesh();
 
@@ -70,15 +155,92 @@ public:
     void selectEdge(QListWidgetItem *comp);
     void selectJoint(QTreeWidgetItem *comp);
 
-    // refreshes the mesh after any changes by destroying then creating m_mesh and selected, and then calling update()
+    // The parts of the scene an edit can leave out of date. Edits only mark
+    // them, and the next paintGL brings each one up to date once before
+    // drawing, so a burst of edits costs a single rebuild.
+    enum Dirty {
+        DIRTY_MESH = 1,      // m_mesh's buffers are rebuilt
+        DIRTY_PATCHES = 2,   // dirtyVerts and dirtyFaces are patched into m_mesh's buffers
+        DIRTY_SELECTION = 4, // selected's buffers are rebuilt
+        DIRTY_SKELETON = 8,  // the skin palette and the joint gizmos are refilled
+        DIRTY_VIEW = 16,     // the camera may have moved; the frame is only drawn again if it did
+        DIRTY_FRAME = 32,    // the frame is drawn again, e.g. after a display mode changed
+        DIRTY_OVERLAYS = 64, // the vertex and wireframe overlays are rebuilt (also done by any m_mesh rebuild)
+        DIRTY_SCENE = 128    // meshes and instances added to m_scene are uploaded
+    };
+
+    // Marks the given Dirty parts and schedules a repaint
+    void markDirty(int parts);
+
+    // refreshes the mesh after any changes: m_mesh, selected and the skeleton
+    // are all rebuilt before the next frame
     void refreshMesh();
 
+    // Lighter versions of refreshMesh() for edits that keep the topology: they
+    // patch the affected corners of m_mesh in place (falling back to a full
+    // rebuild if that isn't possible) and only rebuild what else the edit
+    // touches
+    void refreshVertex(Vertex *v);
+    void refreshFace(Face *f);
+    void refreshSkeleton();
+    void refreshSelection();
+
+    // Draws the frame again without rebuilding anything
+    void redraw();
+
     // Used to split an edge into two edges with a vertex in the middle
     void addVertex(QListWidgetItem *selected);
 
     // Used to triangulate polygons with more than 3 angles using the fan out method
     void triangulate(QListWidgetItem *selected);
 
+    // The topology edits behind addVertex() and triangulate(). These don't touch the
+    // selection, the QListWidgets or the GPU buffers, so they can be called many
+    // times in a row followed by a single refresh.
+    Vertex *splitEdge(HalfEdge *e);
+    void triangulateFace(Face *f);
+
+    // Batch versions of addVertex() and triangulate() that go over the mesh in one
+    // pass and then notify the UI and refresh the buffers once
+    void triangulateAll();
+    void splitAllEdges();
+    void splitEdges(const std::vector<HalfEdge*> &edges);
+
+    // Runs the given number of Taubin smoothing iterations on m_mesh and then
+    // refreshes the buffers once
+    void smoothMesh(LaplacianSmoother::Weighting weighting, int iterations);
+
+    // Decimates m_mesh into m_lods
+    void buildLODs();
+
+    // Prints the vertex cache misses per triangle of drawing m_mesh with
+    // shared vertices in creation order, cluster order and reordered
+    void reportVertexCache();
+
+    // Picks the buffer layout of m_mesh (see Mesh::sharedVertices) and rebuilds it
+    void setSharedVertices(bool shared);
+
+    // Prints the average frame time with the antialiasing as it was, and
+    // switches it
+    void setAntiAliasing(AntiAliasing::Mode mode);
+    AntiAliasing::Mode antiAliasing() const;
+
+    // Shows or hides every vertex of m_mesh as a point and every edge as a
+    // line, drawn over the mesh with the selection highlighted
+    void setVertexOverlay(bool shown);
+    void setWireframeOverlay(bool shown);
+
+    // Loads an OBJ file into m_scene as a herd of rows by columns copies,
+    // each turned a different way, in rows behind m_mesh. The copies share
+    // one set of buffers and are drawn in one call. The file is loaded on
+    // m_uploader's thread, and the herd shows up once its buffers are done.
+    void loadHerd(const std::string &fileName, int rows, int columns);
+    // Removes every herd from m_scene
+    void clearHerds();
+
+    // Switches the skinning of a bound m_mesh between matrices and dual quaternions
+    void setDualQuatSkinning(bool dualQuat);
+
     // Checks if the mouseclick was in the vicinity of a vertex
     Vertex *checkBounds(glm::vec2 pos);
 
@@ -87,9 +249,15 @@ public:
     std::vector<glm::vec3> getSumVals(Vertex *v, std::vector<glm::vec3> &centroids);
     void quadrangulate(Face *f, glm::vec3 centroid);
 
-    // takes in the root joint, and calls draw() on all its children
-    // using the given ShaderProgram
-    void drawJointFamily(Joint *j, ShaderProgram &shader);
+    // One Catmull-Clark step on a mesh whose faces all have N vertices, or on a
+    // mesh with mixed faces when N is 0. Fixing N at compile time lets the
+    // per-face loops unroll and use fixed-size storage.
+    template <int N>
+    void catmullClarkStep();
+
+    // quadrangulate() for a face that had N vertices before its edges were split
+    template <int N>
+    void quadrangulateFixed(Face *f, glm::vec3 centroid);
 
     // Calls the function in Joint that loads a new skeleton from a .json file
     void initSkeleton(std::string fileName);
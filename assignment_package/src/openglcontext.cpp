@@ -5,11 +5,13 @@
 #include <QApplication>
 #include <QProcessEnvironment>
 #include <QOpenGLContext>
+#include <QOpenGLDebugLogger>
 #include <QDebug>
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
+    : QOpenGLWidget(parent), currentProgram(0), stateCallsIssued(0), stateCallsSkipped(0),
+      debugLogger(nullptr), debugOutputOn(false), pollErrors(false)
 {
 }
 
@@ -17,6 +19,12 @@ OpenGLContext::~OpenGLContext()
 {
 }
 
+void OpenGLContext::resetStateStats()
+{
+    stateCallsIssued = 0;
+    stateCallsSkipped = 0;
+}
+
 inline const char *glGS(GLenum e)
 {
     return reinterpret_cast<const char *>(glGetString(e));
@@ -72,8 +80,65 @@ void OpenGLContext::debugContextVersion()
     }
 }
 
+bool OpenGLContext::supportsPackedNormals()
+{
+    QOpenGLContext *ctx = context();
+    QSurfaceFormat form = ctx->format();
+    return form.version() >= qMakePair(3, 3)
+        || ctx->hasExtension("GL_ARB_vertex_type_2_10_10_10_rev");
+}
+
+void OpenGLContext::setDebugOutput(bool enabled)
+{
+    makeCurrent();
+    debugOutputOn = enabled;
+    pollErrors = false;
+    if (!enabled) {
+        if (debugLogger && debugLogger->isLogging()) {
+            debugLogger->stopLogging();
+        }
+        std::cout << "GL debug output off" << std::endl;
+        return;
+    }
+
+    if (debugLogger == nullptr && context()->hasExtension("GL_KHR_debug")) {
+        debugLogger = new QOpenGLDebugLogger(this);
+        if (debugLogger->initialize()) {
+            connect(debugLogger, SIGNAL(messageLogged(QOpenGLDebugMessage)),
+                    this, SLOT(debugMessage(QOpenGLDebugMessage)));
+        } else {
+            delete debugLogger;
+            debugLogger = nullptr;
+        }
+    }
+
+    if (debugLogger) {
+        debugLogger->startLogging(QOpenGLDebugLogger::SynchronousLogging);
+        // Notifications (buffer placement and the like) would bury the rest
+        debugLogger->disableMessages(QOpenGLDebugMessage::AnySource, QOpenGLDebugMessage::AnyType,
+                                     QOpenGLDebugMessage::NotificationSeverity);
+        std::cout << "GL debug output on (KHR_debug)" << std::endl;
+    } else {
+        pollErrors = true;
+        std::cout << "GL debug output on (glGetError after every draw, no KHR_debug)" << std::endl;
+    }
+}
+
+bool OpenGLContext::debugOutput() const
+{
+    return debugOutputOn;
+}
+
+void OpenGLContext::debugMessage(const QOpenGLDebugMessage &message)
+{
+    qDebug() << message;
+}
+
 void OpenGLContext::printGLErrorLog()
 {
+    if (!pollErrors) {
+        return;
+    }
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
         std::cerr << "OpenGL error " << error << ": ";
@@ -2,6 +2,9 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_3_2_Core>
+#include <QOpenGLDebugMessage>
+
+class QOpenGLDebugLogger;
 
 class OpenGLContext
     : public QOpenGLWidget,
@@ -20,11 +23,54 @@ public:
     ~OpenGLContext();
 
     void debugContextVersion();
+
+    // True if GL_INT_2_10_10_10_REV can be used as a vertex attribute type,
+    // which needs OpenGL 3.3 or ARB_vertex_type_2_10_10_10_rev
+    bool supportsPackedNormals();
+
+    // Whether GL errors and driver warnings are reported, which debug builds
+    // start with. It also decides whether main() asks for a debug context.
+#ifdef QT_NO_DEBUG
+    static const bool DEBUG_OUTPUT_DEFAULT = false;
+#else
+    static const bool DEBUG_OUTPUT_DEFAULT = true;
+#endif
+
+    // Turns the reporting of GL errors and driver warnings on or off. With
+    // KHR_debug, the driver reports them through debugMessage() from inside
+    // the GL call that caused them, and nothing is polled. Without it,
+    // printGLErrorLog() falls back to glGetError.
+    virtual void setDebugOutput(bool enabled);
+    bool debugOutput() const;
+
+    // Checks glGetError, but only while the debug output is on without
+    // KHR_debug; otherwise it makes no GL call at all, so it's free to leave
+    // after every draw
     void printGLErrorLog();
+
+    // The program last bound by a ShaderProgram, so the others can skip
+    // binding it again
+    GLuint currentProgram;
+
+    // Program binds and uniform uploads the ShaderProgram state cache issued
+    // and skipped, counted up over a frame by the renderer
+    int stateCallsIssued;
+    int stateCallsSkipped;
+    void resetStateStats();
+
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
 
+private:
+    QOpenGLDebugLogger *debugLogger; // null until the debug output is first turned on, or if there's no KHR_debug
+    bool debugOutputOn;
+    bool pollErrors; // true if printGLErrorLog() has to check glGetError
+
 private slots:
+    // Prints a message the driver logged through KHR_debug. The logging is
+    // synchronous, so a breakpoint here stops inside the offending call.
+    void debugMessage(const QOpenGLDebugMessage &message);
+
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
     /***/ void saveImageAndQuit();
 
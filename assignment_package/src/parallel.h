@@ -0,0 +1,134 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits [0, count) into contiguous ranges and calls f(begin, end) for each of
+// them on its own thread, with the calling thread taking the first range.
+// Fewer threads are started when each would get less than minPerThread items,
+// and threads <= 0 uses one per hardware thread.
+inline int rangeThreads(int count, int minPerThread, int threads)
+{
+    if (threads <= 0){
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::min(threads, std::max(1, count / std::max(1, minPerThread)));
+}
+
+template <typename F>
+void parallelRanges(int count, int minPerThread, F f, int threads = 0)
+{
+    threads = rangeThreads(count, minPerThread, threads);
+
+    std::vector<std::thread> workers;
+    int chunk = (count + threads - 1) / threads;
+    for (int t = 1; t < threads; t++){
+        int begin = std::min(count, t * chunk);
+        int end = std::min(count, begin + chunk);
+        workers.emplace_back(f, begin, end);
+    }
+    f(0, std::min(count, chunk));
+    for (std::thread &w : workers){
+        w.join();
+    }
+}
+
+// The ranges of parallelRanges() for work that's run over the same count
+// many times in a row. The threads are started once, wait between calls to
+// run(), and are stopped when this is destroyed.
+class RangeWorkers
+{
+public:
+    RangeWorkers(int count, int minPerThread, int threads = 0)
+        : job(nullptr), generation(0), running(0), stopping(false)
+    {
+        threads = rangeThreads(count, minPerThread, threads);
+        int chunk = (count + threads - 1) / threads;
+        for (int t = 0; t < threads; t++){
+            int begin = std::min(count, t * chunk);
+            ranges.emplace_back(begin, std::min(count, begin + chunk));
+        }
+        for (int t = 1; t < threads; t++){
+            workers.emplace_back(&RangeWorkers::work, this, t);
+        }
+    }
+
+    ~RangeWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for (std::thread &w : workers){
+            w.join();
+        }
+    }
+
+    RangeWorkers(const RangeWorkers &) = delete;
+    RangeWorkers &operator=(const RangeWorkers &) = delete;
+
+    // Calls f(begin, end) for each range, the first on the calling thread,
+    // and returns once all of them are done
+    void run(const std::function<void(int, int)> &f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &f;
+            running = workers.size();
+            generation++;
+        }
+        started.notify_all();
+        f(ranges[0].first, ranges[0].second);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]{ return running == 0; });
+        job = nullptr;
+    }
+
+    int threadCount() const
+    {
+        return ranges.size();
+    }
+
+private:
+    std::vector<std::pair<int, int>> ranges;
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable started;  // a run() began, or the workers are stopping
+    std::condition_variable finished; // the last worker of a run() is done
+    const std::function<void(int, int)> *job;
+    int generation; // run() calls so far, so each worker takes each one once
+    int running;    // workers still busy with the current run()
+    bool stopping;
+
+    void work(int t)
+    {
+        int seen = 0;
+        for (;;){
+            const std::function<void(int, int)> *f;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                started.wait(lock, [&]{ return stopping || generation != seen; });
+                if (stopping){
+                    return;
+                }
+                seen = generation;
+                f = job;
+            }
+            (*f)(ranges[t].first, ranges[t].second);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running--;
+            }
+            finished.notify_one();
+        }
+    }
+};
+
+#endif // PARALLEL_H
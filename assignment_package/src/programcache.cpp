@@ -0,0 +1,121 @@
+#include "programcache.h"
+#include <QOpenGLContext>
+#include <QStandardPaths>
+#include <QDir>
+#include <QFile>
+#include <QCryptographicHash>
+#include <iostream>
+#include <cstring>
+
+ProgramCache::ProgramCache(OpenGLContext *context)
+    : context(context), getProgramBinary(nullptr), programBinary(nullptr),
+      programParameteri(nullptr), directory(), driver()
+{}
+
+void ProgramCache::init()
+{
+    QOpenGLContext *ctx = context->context();
+    if (ctx->format().version() >= qMakePair(4, 1)
+            || ctx->hasExtension("GL_ARB_get_program_binary")){
+        getProgramBinary = reinterpret_cast<GetProgramBinary>(ctx->getProcAddress("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinary>(ctx->getProcAddress("glProgramBinary"));
+        programParameteri = reinterpret_cast<ProgramParameteri>(ctx->getProcAddress("glProgramParameteri"));
+    }
+
+    // Some drivers have the functions but no format to save a binary in
+    GLint formats = 0;
+    if (getProgramBinary && programBinary && programParameteri){
+        context->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+
+    directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+    if (formats <= 0 || !QDir().mkpath(directory)){
+        getProgramBinary = nullptr;
+        programBinary = nullptr;
+        programParameteri = nullptr;
+        std::cerr << "Program binaries unavailable, every shader variant is compiled" << std::endl;
+        return;
+    }
+
+    for (GLenum e : {GL_VENDOR, GL_RENDERER, GL_VERSION}){
+        const GLubyte *s = context->glGetString(e);
+        driver += s ? reinterpret_cast<const char*>(s) : "";
+        driver += '\n';
+    }
+}
+
+bool ProgramCache::enabled() const
+{
+    return programBinary != nullptr;
+}
+
+QString ProgramCache::key(const std::string &vertSource, const std::string &fragSource) const
+{
+    // The terminating nulls keep the sources apart, so that moving text from
+    // the end of one to the start of the other changes the key
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(vertSource.c_str(), vertSource.size() + 1);
+    hash.addData(fragSource.c_str(), fragSource.size() + 1);
+    hash.addData(driver.c_str(), driver.size());
+    return QString(hash.result().toHex()) + ".bin";
+}
+
+void ProgramCache::prepare(GLuint prog)
+{
+    if (enabled()){
+        programParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+// A cached file is the binary's format followed by the binary itself
+bool ProgramCache::load(GLuint prog, const QString &key)
+{
+    QFile file(QDir(directory).filePath(key));
+    if (!enabled() || !file.open(QIODevice::ReadOnly)){
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+    if (data.size() <= int(sizeof(GLenum))){
+        return false;
+    }
+
+    GLenum format;
+    std::memcpy(&format, data.constData(), sizeof(GLenum));
+    programBinary(prog, format, data.constData() + sizeof(GLenum), data.size() - sizeof(GLenum));
+
+    // A binary from a format the driver no longer accepts is an error rather
+    // than just a failed link, and neither should reach printGLErrorLog
+    context->glGetError();
+    GLint linked = GL_FALSE;
+    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+    if (!linked){
+        return false;
+    }
+    return true;
+}
+
+void ProgramCache::store(GLuint prog, const QString &key)
+{
+    if (!enabled()){
+        return;
+    }
+    GLint length = 0;
+    context->glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0){
+        return;
+    }
+
+    QByteArray data;
+    data.resize(sizeof(GLenum) + length);
+    GLenum format = 0;
+    getProgramBinary(prog, length, &length, &format, data.data() + sizeof(GLenum));
+    std::memcpy(data.data(), &format, sizeof(GLenum));
+    data.resize(sizeof(GLenum) + length);
+
+    QFile file(QDir(directory).filePath(key));
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        file.write(data);
+        file.close();
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <openglcontext.h>
+#include <QString>
+#include <string>
+
+// Linked shader programs saved to disk with glGetProgramBinary, so that later
+// launches can load them with glProgramBinary instead of compiling and linking
+// the sources again. Each binary is stored under a hash of the two sources it
+// was built from and the driver that built it, so editing a shader or
+// updating the driver just misses the cache.
+//
+// Program binaries are core in OpenGL 4.1 and come with
+// ARB_get_program_binary before that; the 3.2 Core functions don't have them,
+// so they're resolved from the context in init(). Without them the cache is
+// disabled and every program is compiled.
+class ProgramCache
+{
+private:
+    typedef void (QOPENGLF_APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+    typedef void (QOPENGLF_APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+    typedef void (QOPENGLF_APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value);
+
+    OpenGLContext *context;
+    GetProgramBinary getProgramBinary;
+    ProgramBinary programBinary;
+    ProgramParameteri programParameteri;
+
+    QString directory; // where the binaries are kept
+    std::string driver; // the vendor, renderer and version strings, hashed into every key
+
+public:
+    ProgramCache(OpenGLContext *context);
+
+    // Resolves the program binary functions and picks the cache directory.
+    // Needs a current context.
+    void init();
+
+    bool enabled() const;
+
+    // Returns the name the binary of the program built from these sources is
+    // stored under
+    QString key(const std::string &vertSource, const std::string &fragSource) const;
+
+    // Marks prog's binary as wanted, before it's linked
+    void prepare(GLuint prog);
+
+    // Loads the binary stored under key into prog. Returns false if there is
+    // none or the driver rejected it, in which case prog has to be compiled.
+    bool load(GLuint prog, const QString &key);
+
+    // Saves the binary of the linked program prog under key
+    void store(GLuint prog, const QString &key);
+};
+
+#endif // PROGRAMCACHE_H
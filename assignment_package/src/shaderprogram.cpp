@@ -4,58 +4,104 @@
 #include <iostream>
 #include <exception>
 #include <assert.h>
+#include <skinpalette.h>
+#include <frameconstants.h>
 
 
 ShaderProgram::ShaderProgram(OpenGLContext *context)
     : vertShader(), fragShader(), prog(),
       attrPos(-1), attrNor(-1), attrCol(-1),
-      unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifCamPos(-1),
+      unifModel(-1), unifModelInvTr(-1),
+      unifPalette(-1), unifFaceCol(-1), unifTriangleBase(-1), unifInstances(-1), unifInstanceBase(-1), fromCache(false),
+      cache(nullptr), cacheKey(), cachedModel(), modelCached(false), cachedTriangleBase(-1), cachedInstanceBase(-1),
       context(context)
 {}
 
-void ShaderProgram::create(const char *vertfile, const char *fragfile)
+std::string ShaderProgram::withDefines(const std::string &source, const std::string &defines)
 {
-    // Allocate space on our GPU for a vertex shader and a fragment shader and a shader program to manage the two
-    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
-    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
+    // The #version line has to stay first
+    size_t lineEnd = source.find('\n');
+    if (defines.empty() || lineEnd == std::string::npos) {
+        return source;
+    }
+    return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+void ShaderProgram::create(const char *vertfile, const char *fragfile, const std::string &defines,
+                           ProgramCache *cache)
+{
+    begin(vertfile, fragfile, defines, cache);
+    finish();
+}
+
+void ShaderProgram::begin(const char *vertfile, const char *fragfile, const std::string &defines,
+                          ProgramCache *cache)
+{
+    this->cache = cache;
     prog = context->glCreateProgram();
     // Get the body of text stored in our two .glsl files
     QString qVertSource = qTextFileRead(vertfile);
     QString qFragSource = qTextFileRead(fragfile);
 
-    char* vertSource = new char[qVertSource.size()+1];
-    strcpy(vertSource, qVertSource.toStdString().c_str());
-    char* fragSource = new char[qFragSource.size()+1];
-    strcpy(fragSource, qFragSource.toStdString().c_str());
+    std::string vertText = withDefines(qVertSource.toStdString(), defines);
+    std::string fragText = withDefines(qFragSource.toStdString(), defines);
+
+    // A program linked on an earlier run needs no compiling at all
+    if (cache) {
+        cacheKey = cache->key(vertText, fragText);
+        fromCache = cache->load(prog, cacheKey);
+        if (fromCache) {
+            return;
+        }
+    }
+
+    // Allocate space on our GPU for a vertex shader and a fragment shader
+    vertShader = context->glCreateShader(GL_VERTEX_SHADER);
+    fragShader = context->glCreateShader(GL_FRAGMENT_SHADER);
+
+    const char* vertSource = vertText.c_str();
+    const char* fragSource = fragText.c_str();
 
 
     // Send the shader text to OpenGL and store it in the shaders specified by the handles vertShader and fragShader
     context->glShaderSource(vertShader, 1, &vertSource, 0);
     context->glShaderSource(fragShader, 1, &fragSource, 0);
-    // Tell OpenGL to compile the shader text stored above
+    // Tell OpenGL to compile the shader text stored above. Nothing is
+    // queried until finish(), so the driver doesn't have to stop and wait.
     context->glCompileShader(vertShader);
     context->glCompileShader(fragShader);
-    // Check if everything compiled OK
-    GLint compiled;
-    context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(vertShader);
-    }
-    context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
-    if (!compiled) {
-        printShaderInfoLog(fragShader);
-    }
 
     // Tell prog that it manages these particular vertex and fragment shaders
     context->glAttachShader(prog, vertShader);
     context->glAttachShader(prog, fragShader);
+    if (cache) {
+        cache->prepare(prog);
+    }
     context->glLinkProgram(prog);
+}
 
-    // Check for linking success
-    GLint linked;
-    context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
-    if (!linked) {
-        printLinkInfoLog(prog);
+void ShaderProgram::finish()
+{
+    if (!fromCache) {
+        // Check if everything compiled OK
+        GLint compiled;
+        context->glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            printShaderInfoLog(vertShader);
+        }
+        context->glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            printShaderInfoLog(fragShader);
+        }
+
+        // Check for linking success
+        GLint linked;
+        context->glGetProgramiv(prog, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            printLinkInfoLog(prog);
+        } else if (cache) {
+            cache->store(prog, cacheKey);
+        }
     }
 
     // Get the handles to the variables stored in our shaders
@@ -69,21 +115,58 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
 
     unifModel      = context->glGetUniformLocation(prog, "u_Model");
     unifModelInvTr = context->glGetUniformLocation(prog, "u_ModelInvTr");
-    unifViewProj   = context->glGetUniformLocation(prog, "u_ViewProj");
-    unifCamPos      = context->glGetUniformLocation(prog, "u_CamPos");
-    unifBindMatrices = context->glGetUniformLocation(prog, "u_Bind");
-    unifTransformations = context->glGetUniformLocation(prog, "u_Trans");
+    unifPalette     = context->glGetUniformLocation(prog, "u_Palette");
+    unifFaceCol     = context->glGetUniformLocation(prog, "u_FaceCol");
+    unifTriangleBase = context->glGetUniformLocation(prog, "u_TriangleBase");
+    unifInstances   = context->glGetUniformLocation(prog, "u_Instances");
+    unifInstanceBase = context->glGetUniformLocation(prog, "u_InstanceBase");
+
+    // The camera is shared by all programs through the FrameConstants block
+    GLuint frameBlock = context->glGetUniformBlockIndex(prog, "FrameConstants");
+    if (frameBlock != GL_INVALID_INDEX) {
+        context->glUniformBlockBinding(prog, frameBlock, FrameConstants::BINDING);
+    }
+
+    // Drawables bind their per-triangle colours to texture unit 0 and their
+    // instance data to Drawable::INSTANCE_TEXTURE_UNIT, and the skin palette
+    // sits on its own unit
+    if (unifFaceCol != -1 || unifPalette != -1 || unifInstances != -1) {
+        useMe();
+    }
+    if (unifFaceCol != -1) {
+        context->glUniform1i(unifFaceCol, 0);
+    }
+    if (unifPalette != -1) {
+        context->glUniform1i(unifPalette, SkinPalette::TEXTURE_UNIT);
+    }
+    if (unifInstances != -1) {
+        context->glUniform1i(unifInstances, Drawable::INSTANCE_TEXTURE_UNIT);
+    }
 }
 
 void ShaderProgram::useMe()
 {
+    if (context->currentProgram == prog) {
+        context->stateCallsSkipped++;
+        return;
+    }
     context->glUseProgram(prog);
+    context->currentProgram = prog;
+    context->stateCallsIssued++;
 }
 
-
-
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
+    if (unifModel == -1 && unifModelInvTr == -1) {
+        return;
+    }
+    if (modelCached && model == cachedModel) {
+        context->stateCallsSkipped += (unifModel != -1) + (unifModelInvTr != -1);
+        return;
+    }
+    cachedModel = model;
+    modelCached = true;
+
     useMe();
 
     if (unifModel != -1) {
@@ -96,10 +179,12 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
                            GL_FALSE,
                         // Pointer to the first element of the matrix
                            &model[0][0]);
+        context->stateCallsIssued++;
     }
 
     if (unifModelInvTr != -1) {
-        glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+        // The identity is its own inverse transpose
+        glm::mat4 modelinvtr = model == glm::mat4(1.f) ? model : glm::inverse(glm::transpose(model));
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
         context->glUniformMatrix4fv(unifModelInvTr,
@@ -109,148 +194,172 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
                            GL_FALSE,
                         // Pointer to the first element of the matrix
                            &modelinvtr[0][0]);
+        context->stateCallsIssued++;
     }
 }
 
-void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
+//This function, as its name implies, uses the passed in GL widget
+void ShaderProgram::draw(Drawable &d)
 {
-    // Tell OpenGL to use this shader program for subsequent function calls
+    if(d.elemCount() < 0) {
+        throw std::invalid_argument(
+        "Attempting to draw a Drawable that has not initialized its count variable! Remember to set it to the length of your index array in create()."
+        );
+    }
     useMe();
 
-    if(unifViewProj != -1) {
-    // Pass a 4x4 matrix into a uniform variable in our shader
-                    // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
-                    // How many matrices to pass
-                       1,
-                    // Transpose the matrix? OpenGL uses column-major, so no.
-                       GL_FALSE,
-                    // Pointer to the first element of the matrix
-                       &vp[0][0]);
+    // Drawables with shared vertices have no per-vertex colour, so variants
+    // compiled with FACE_COLOURS read the colour of each triangle from their
+    // buffer texture
+    if (unifFaceCol != -1) {
+        d.bindFaceCol();
+    }
+    if (unifInstances != -1) {
+        d.bindInst();
     }
-}
 
-void ShaderProgram::setCamPos(glm::vec3 pos)
-{
-    useMe();
+    // The attribute setup and the index buffer binding live in a VAO that is
+    // filled in the first time d is drawn with this program, so from then on a
+    // draw is just a VAO bind
+    GLuint vao = d.vao(prog);
+    if (vao == 0) {
+        vao = d.generateVao(prog);
+        context->glBindVertexArray(vao);
+        setupAttributes(d);
+    } else {
+        context->glBindVertexArray(vao);
+    }
 
-    if(unifCamPos != -1)
-    {
-        context->glUniform3fv(unifCamPos, 1, &pos[0]);
+    // This invokes the shader program, which accesses the vertex buffers.
+    // Instanced Drawables are drawn instanceCount() times in the one call,
+    // and Drawables limited to some ranges of their indices draw only those.
+    // Streamed vertices and instances are read from the region last written.
+    if (d.instanceCount() > 0) {
+        setTriangleBase(0);
+        setInstanceBase(d.instanceBase());
+        context->glDrawElementsInstancedBaseVertex(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0,
+                                                   d.instanceCount(), d.baseVertex());
+    } else if (d.rangeCount() < 0) {
+        setTriangleBase(0);
+        context->glDrawElementsBaseVertex(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0, d.baseVertex());
+    } else if (unifTriangleBase != -1) {
+        // gl_PrimitiveID starts over at every draw of a glMultiDrawElements,
+        // so variants that look up the triangle colours draw the ranges one
+        // by one, each told where it starts
+        for (int i = 0; i < d.rangeCount(); i++) {
+            setTriangleBase(d.rangeTriangle(i));
+            context->glDrawElements(d.drawMode(), d.rangeCounts()[i], GL_UNSIGNED_INT, d.rangeStarts()[i]);
+        }
+    } else if (d.rangeCount() > 0) {
+        context->glMultiDrawElements(d.drawMode(), d.rangeCounts(), GL_UNSIGNED_INT, d.rangeStarts(), d.rangeCount());
     }
-}
 
-void ShaderProgram::setBindMatrix(const std::vector<glm::mat4> &bindMats)
-{
-    useMe();
+    // Unbound again so that index buffers bound while creating other
+    // Drawables don't end up in this one's VAO
+    context->glBindVertexArray(0);
+    d.fenceStreams();
 
-    if (unifBindMatrices != -1)
-    {
-        context->glUniformMatrix4fv(unifBindMatrices,
-                        // How many matrices to pass
-                           100,
-                        // Transpose the matrix? OpenGL uses column-major, so no.
-                           GL_FALSE,
-                        // Pointer to the first element of the matrix
-                           &bindMats[0][0][0]);
-    }
+    context->printGLErrorLog();
 }
 
-void ShaderProgram::setTransMatrix(const std::vector<glm::mat4> &transMats)
+void ShaderProgram::setTriangleBase(int base)
 {
-    useMe();
-
-    if (unifBindMatrices != -1)
-    {
-        context->glUniformMatrix4fv(unifTransformations,
-                        // How many matrices to pass
-                           100,
-                        // Transpose the matrix? OpenGL uses column-major, so no.
-                           GL_FALSE,
-                        // Pointer to the first element of the matrix
-                           &(transMats[0][0][0]));
+    if (unifTriangleBase == -1) {
+        return;
     }
+    if (base == cachedTriangleBase) {
+        context->stateCallsSkipped++;
+        return;
+    }
+    context->glUniform1i(unifTriangleBase, base);
+    cachedTriangleBase = base;
+    context->stateCallsIssued++;
 }
 
-//This function, as its name implies, uses the passed in GL widget
-void ShaderProgram::draw(Drawable &d)
+void ShaderProgram::setInstanceBase(int base)
 {
-    if(d.elemCount() < 0) {
-        throw std::invalid_argument(
-        "Attempting to draw a Drawable that has not initialized its count variable! Remember to set it to the length of your index array in create()."
-        );
+    if (unifInstanceBase == -1) {
+        return;
     }
-    useMe();
-
-    // Each of the following blocks checks that:
-    //   * This shader has this attribute, and
-    //   * This Drawable has a vertex buffer for this attribute.
-    // If so, it binds the appropriate buffers to each attribute.
-
-        // Remember, by calling bindPos(), we call
-        // glBindBuffer on the Drawable's VBO for vertex position,
-        // meaning that glVertexAttribPointer associates vs_Pos
-        // (referred to by attrPos) with that VBO
-    if (attrPos != -1 && d.bindPos()) {
-        context->glEnableVertexAttribArray(attrPos);
-        context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, nullptr);
+    if (base == cachedInstanceBase) {
+        context->stateCallsSkipped++;
+        return;
     }
+    context->glUniform1i(unifInstanceBase, base);
+    cachedInstanceBase = base;
+    context->stateCallsIssued++;
+}
 
-    if (attrNor != -1 && d.bindNor()) {
-        context->glEnableVertexAttribArray(attrNor);
-        context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, nullptr);
-    }
+// Records d's buffers and attribute pointers in the currently bound VAO
+void ShaderProgram::setupAttributes(Drawable &d)
+{
+    if (d.bindVert()) {
+        // Interleaved buffers carry their own layout, so every attribute is
+        // set up from its descriptor
+        const VertexLayout &layout = d.vertexLayout();
+        for (const VertexAttribute &a : layout.attributes) {
+            int loc = attribLocation(a.input);
+            if (loc == -1) {
+                continue;
+            }
+            context->glEnableVertexAttribArray(loc);
+            if (a.integer) {
+                context->glVertexAttribIPointer(loc, a.size, a.type, layout.stride,
+                                                reinterpret_cast<void*>(a.offset));
+            } else {
+                context->glVertexAttribPointer(loc, a.size, a.type, a.normalized, layout.stride,
+                                               reinterpret_cast<void*>(a.offset));
+            }
+        }
+    } else {
+        // Each of the following blocks checks that:
+        //   * This shader has this attribute, and
+        //   * This Drawable has a vertex buffer for this attribute.
+        // If so, it binds the appropriate buffers to each attribute.
+
+            // Remember, by calling bindPos(), we call
+            // glBindBuffer on the Drawable's VBO for vertex position,
+            // meaning that glVertexAttribPointer associates vs_Pos
+            // (referred to by attrPos) with that VBO
+        if (attrPos != -1 && d.bindPos()) {
+            context->glEnableVertexAttribArray(attrPos);
+            context->glVertexAttribPointer(attrPos, 4, GL_FLOAT, false, 0, nullptr);
+        }
 
-    if (attrCol != -1 && d.bindCol()) {
-        context->glEnableVertexAttribArray(attrCol);
-        context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, nullptr);
-    }
+        if (attrNor != -1 && d.bindNor()) {
+            context->glEnableVertexAttribArray(attrNor);
+            context->glVertexAttribPointer(attrNor, 4, GL_FLOAT, false, 0, nullptr);
+        }
 
-    if (attrJnt != -1 && d.bindJnt()) {
-        context->glEnableVertexAttribArray(attrJnt);
-        context->glVertexAttribIPointer(attrJnt, 2, GL_INT, 0, nullptr);
-    }
+        if (attrCol != -1 && d.bindCol()) {
+            context->glEnableVertexAttribArray(attrCol);
+            context->glVertexAttribPointer(attrCol, 4, GL_FLOAT, false, 0, nullptr);
+        }
+
+        if (attrJnt != -1 && d.bindJnt()) {
+            context->glEnableVertexAttribArray(attrJnt);
+            context->glVertexAttribIPointer(attrJnt, 2, GL_INT, 0, nullptr);
+        }
 
-    if (attrInf != -1 && d.bindInf()) {
-        context->glEnableVertexAttribArray(attrInf);
-        context->glVertexAttribPointer(attrInf, 2, GL_FLOAT, false, 0, nullptr);
+        if (attrInf != -1 && d.bindInf()) {
+            context->glEnableVertexAttribArray(attrInf);
+            context->glVertexAttribPointer(attrInf, 2, GL_FLOAT, false, 0, nullptr);
+        }
     }
 
-    // Bind the index buffer and then draw shapes from it.
-    // This invokes the shader program, which accesses the vertex buffers.
     d.bindIdx();
-    context->glDrawElements(d.drawMode(), d.elemCount(), GL_UNSIGNED_INT, 0);
-
-    if (attrPos != -1) context->glDisableVertexAttribArray(attrPos);
-    if (attrNor != -1) context->glDisableVertexAttribArray(attrNor);
-    if (attrCol != -1) context->glDisableVertexAttribArray(attrCol);
-    if (attrJnt != -1) context->glDisableVertexAttribArray(attrJnt);
-    if (attrInf != -1) context->glDisableVertexAttribArray(attrInf);
-
-
-    context->printGLErrorLog();
 }
 
-char* ShaderProgram::textFileRead(const char* fileName) {
-    char* text;
-
-    if (fileName != NULL) {
-        FILE *file = fopen(fileName, "rt");
-
-        if (file != NULL) {
-            fseek(file, 0, SEEK_END);
-            int count = ftell(file);
-            rewind(file);
-
-            if (count > 0) {
-                text = (char*)malloc(sizeof(char) * (count + 1));
-                count = fread(text, sizeof(char), count, file);
-                text[count] = '\0';	//cap off the string with a terminal symbol, fixed by Cory
-            }
-            fclose(file);
-        }
+int ShaderProgram::attribLocation(VertexAttribute::Input input)
+{
+    switch (input) {
+    case VertexAttribute::POS: return attrPos;
+    case VertexAttribute::NOR: return attrNor;
+    case VertexAttribute::COL: return attrCol;
+    case VertexAttribute::JNT: return attrJnt;
+    case VertexAttribute::INF: return attrInf;
     }
-    return text;
+    return -1;
 }
 
 QString ShaderProgram::qTextFileRead(const char *fileName)
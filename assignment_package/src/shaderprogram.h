@@ -4,8 +4,10 @@
 #include <openglcontext.h>
 #include <la.h>
 #include <glm/glm.hpp>
+#include <string>
 
 #include "drawable.h"
+#include <programcache.h>
 
 
 class ShaderProgram
@@ -23,32 +25,39 @@ public:
 
     int unifModel; // A handle for the "uniform" mat4 representing model matrix in the vertex shader
     int unifModelInvTr; // A handle for the "uniform" mat4 representing inverse transpose of the model matrix in the vertex shader
-    int unifViewProj; // A handle for the "uniform" mat4 representing combined projection and view matrices in the vertex shader
-    int unifCamPos; // A handle for the "uniform" vec4 representing color of geometry in the vertex shader
-    int unifBindMatrices;
-    int unifTransformations;
+    int unifPalette; // A handle for the "uniform" samplerBuffer holding the joint transforms (see SkinPalette)
     int unifMainColor;
+    int unifFaceCol; // A handle for the "uniform" samplerBuffer holding the per-triangle colours
+    int unifTriangleBase; // A handle for the "uniform" int added to gl_PrimitiveID to find a triangle's colour
+    int unifInstances; // A handle for the "uniform" samplerBuffer holding the per-instance model matrices and tints
+    int unifInstanceBase; // A handle for the "uniform" int of the texel the first instance starts at
+
+    bool fromCache; // true if the program was loaded from a ProgramCache rather than compiled
 
 public:
     ShaderProgram(OpenGLContext* context);
-    // Sets up the requisite GL data and shaders from the given .glsl files
-    void create(const char *vertfile, const char *fragfile);
-    // Tells our OpenGL context to use this shader to draw things
+    // Sets up the requisite GL data and shaders from the given .glsl files.
+    // defines is inserted into both right after their #version line, to pick
+    // the variant of the shaders to compile. With a cache, the linked program
+    // is loaded from it if it's there, and saved to it if it isn't.
+    void create(const char *vertfile, const char *fragfile, const std::string &defines = "",
+                ProgramCache *cache = nullptr);
+    // create() in two halves: begin() starts compiling and linking without
+    // waiting on the driver, and finish() waits for the result and looks up
+    // the inputs. Beginning several programs before finishing any lets the
+    // driver build them in parallel.
+    void begin(const char *vertfile, const char *fragfile, const std::string &defines = "",
+               ProgramCache *cache = nullptr);
+    void finish();
+    // Tells our OpenGL context to use this shader to draw things, unless it
+    // already is. The camera comes from the FrameConstants uniform buffer.
     void useMe();
-    // Pass the given model matrix to this shader on the GPU
+    // Pass the given model matrix to this shader on the GPU, if it isn't already there
     void setModelMatrix(const glm::mat4 &model);
-    // Pass the given Projection * View matrix to this shader on the GPU
-    void setViewProjMatrix(const glm::mat4 &vp);
-    // Pass the given set of bind matrices to this shader on the GPU
-    void setBindMatrix(const std::vector<glm::mat4> &bindMats);
-    // Pass the given set of transformation matrices to this shader on the GPU
-    void setTransMatrix(const std::vector<glm::mat4> &transMats);
-    // Pass the given color to this shader on the GPU
-    void setCamPos(glm::vec3 pos);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
-    // Utility function used in create()
-    char* textFileRead(const char*);
+    // Returns the location of the given shader input, or -1 if this program doesn't use it
+    int attribLocation(VertexAttribute::Input input);
     // Utility function that prints any shader compilation errors to the console
     void printShaderInfoLog(int shader);
     // Utility function that prints any shader linking errors to the console
@@ -57,6 +66,27 @@ public:
     QString qTextFileRead(const char*);
 
 private:
+    // Enables and points the attributes of d at its buffers, and binds its
+    // index buffer, in the currently bound VAO
+    void setupAttributes(Drawable &d);
+
+    ProgramCache *cache; // where begin() looked for the program, and finish() saves it
+    QString cacheKey;
+
+    // The model matrix last uploaded, so that setting it again costs no GL call
+    glm::mat4 cachedModel;
+    bool modelCached;
+
+    // Same for the triangle base, which is -1 until the first upload
+    int cachedTriangleBase;
+    void setTriangleBase(int base);
+    // and the instance base
+    int cachedInstanceBase;
+    void setInstanceBase(int base);
+
+    // Returns source with defines inserted after its first line
+    static std::string withDefines(const std::string &source, const std::string &defines);
+
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
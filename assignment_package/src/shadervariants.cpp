@@ -0,0 +1,108 @@
+#include "shadervariants.h"
+#include <QOpenGLContext>
+
+// The #define each feature is compiled in with
+static const std::pair<int, const char*> FEATURE_NAMES[] = {
+    {Drawable::SKINNED, "SKINNED"},
+    {Drawable::DUAL_QUAT, "DUAL_QUAT"},
+    {Drawable::LAMBERT, "LAMBERT"},
+    {Drawable::FACE_COLOURS, "FACE_COLOURS"},
+    {Drawable::INSTANCED, "INSTANCED"}
+};
+
+ShaderVariants::ShaderVariants(OpenGLContext *context)
+    : context(context), programs(), cache(context), dualQuat(false), parallelCompile(false)
+{}
+
+void ShaderVariants::init()
+{
+    cache.init();
+
+    // Lets the driver use as many compiler threads as it likes. The programs
+    // are only waited on in ShaderProgram::finish(), so the ones prepare()
+    // begins together compile side by side.
+    typedef void (QOPENGLF_APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+    QOpenGLContext *ctx = context->context();
+    MaxShaderCompilerThreads maxThreads = nullptr;
+    if (ctx->hasExtension("GL_KHR_parallel_shader_compile")){
+        maxThreads = reinterpret_cast<MaxShaderCompilerThreads>(ctx->getProcAddress("glMaxShaderCompilerThreadsKHR"));
+    } else if (ctx->hasExtension("GL_ARB_parallel_shader_compile")){
+        maxThreads = reinterpret_cast<MaxShaderCompilerThreads>(ctx->getProcAddress("glMaxShaderCompilerThreadsARB"));
+    }
+    if (maxThreads){
+        maxThreads(0xFFFFFFFF);
+        parallelCompile = true;
+    }
+}
+
+ShaderProgram *ShaderVariants::find(int features)
+{
+    for (std::pair<int, uPtr<ShaderProgram>> &p : programs){
+        if (p.first == features){
+            return p.second.get();
+        }
+    }
+    return nullptr;
+}
+
+std::string ShaderVariants::defines(int features)
+{
+    std::string defines;
+    for (const std::pair<int, const char*> &f : FEATURE_NAMES){
+        if (features & f.first){
+            defines += std::string("#define ") + f.second + "\n";
+        }
+    }
+    return defines;
+}
+
+ShaderProgram &ShaderVariants::variant(int features)
+{
+    ShaderProgram *found = find(features);
+    if (found){
+        return *found;
+    }
+
+    uPtr<ShaderProgram> prog = mkU<ShaderProgram>(context);
+    prog->create(":/glsl/mesh.vert.glsl", ":/glsl/mesh.frag.glsl", defines(features), &cache);
+    programs.push_back(std::make_pair(features, std::move(prog)));
+    return *programs.back().second;
+}
+
+void ShaderVariants::prepare(const std::vector<int> &featureSets)
+{
+    std::vector<ShaderProgram*> begun;
+    for (int features : featureSets){
+        if (find(features)){
+            continue;
+        }
+        uPtr<ShaderProgram> prog = mkU<ShaderProgram>(context);
+        prog->begin(":/glsl/mesh.vert.glsl", ":/glsl/mesh.frag.glsl", defines(features), &cache);
+        begun.push_back(prog.get());
+        programs.push_back(std::make_pair(features, std::move(prog)));
+    }
+    for (ShaderProgram *prog : begun){
+        prog->finish();
+    }
+}
+
+int ShaderVariants::features(Drawable &d, int wanted)
+{
+    int features = d.shaderFeatures() & (wanted | Drawable::FACE_COLOURS | Drawable::INSTANCED);
+    if (dualQuat && (features & Drawable::SKINNED)){
+        features |= Drawable::DUAL_QUAT;
+    }
+    return features;
+}
+
+void ShaderVariants::draw(Drawable &d, const glm::mat4 &model, int wanted)
+{
+    ShaderProgram &prog = variant(features(d, wanted));
+    prog.setModelMatrix(model);
+    prog.draw(d);
+}
+
+int ShaderVariants::variantCount()
+{
+    return programs.size();
+}
@@ -0,0 +1,68 @@
+#ifndef SHADERVARIANTS_H
+#define SHADERVARIANTS_H
+
+#include <shaderprogram.h>
+#include <programcache.h>
+#include <smartpointerhelp.h>
+#include <vector>
+#include <utility>
+
+// Every combination of Drawable::ShaderFeature the mesh shaders are drawn
+// with, compiled from glsl/mesh.vert.glsl and glsl/mesh.frag.glsl with a
+// #define per feature. A variant is only compiled the first time a Drawable
+// needs it, and it only declares the inputs and uniforms its features use, so
+// the shaders never branch on a feature and nothing is uploaded for one a
+// Drawable doesn't have. Linked variants are kept in a ProgramCache, so they
+// only have to be compiled on the first launch.
+class ShaderVariants
+{
+private:
+    OpenGLContext *context;
+
+    // (features, program) pairs
+    std::vector<std::pair<int, uPtr<ShaderProgram>>> programs;
+
+    ProgramCache cache;
+
+    // Returns the program for the given features if it was already compiled,
+    // or nullptr
+    ShaderProgram *find(int features);
+
+    // Returns the #defines that compile the given features in
+    static std::string defines(int features);
+
+public:
+    ShaderVariants(OpenGLContext *context);
+
+    // Adds DUAL_QUAT to every skinned draw, to match the skin palette's mode
+    bool dualQuat;
+
+    // True if the driver compiles shaders on threads of its own
+    // (KHR_parallel_shader_compile)
+    bool parallelCompile;
+
+    // Sets up the program cache and parallel compiling. Needs a current
+    // context, and has to come before any variant is compiled.
+    void init();
+
+    // Builds the variants for each of the given feature sets up front, all at
+    // once so the driver can work on them in parallel
+    void prepare(const std::vector<int> &featureSets);
+
+    // The features d is drawn with when the given ones are wanted
+    int features(Drawable &d, int wanted);
+
+    // Returns the program compiled with exactly the given features, compiling
+    // it if this is the first time it's needed
+    ShaderProgram &variant(int features);
+
+    // Draws d with model as its model matrix. The variant has the features d's
+    // data provides (see Drawable::shaderFeatures) that are also in wanted.
+    // FACE_COLOURS and INSTANCED are always kept, since those Drawables have
+    // no other colour or placement.
+    void draw(Drawable &d, const glm::mat4 &model, int wanted);
+
+    int variantCount();
+};
+
+#endif // SHADERVARIANTS_H
@@ -0,0 +1,93 @@
+#include "skinpalette.h"
+#include <algorithm>
+#include <cstring>
+#include <glm/gtx/dual_quaternion.hpp>
+
+SkinPalette::SkinPalette(OpenGLContext *context)
+    : context(context), buf(), tex(), generated(false), capacity(0), slotCount(0),
+      mode(MATRICES)
+{}
+
+int SkinPalette::texelsPerJoint()
+{
+    return mode == MATRICES ? 4 : 2;
+}
+
+bool SkinPalette::update(const std::vector<Joint*> &joints)
+{
+    unsigned int maxID = 0;
+    for (Joint *j : joints){
+        maxID = std::max(maxID, j->iD);
+    }
+    int jointSlots = joints.empty() ? 0 : maxID + 1;
+    int texels = texelsPerJoint();
+    staged.assign(jointSlots * texels, glm::vec4(0.f));
+    for (Joint *j : joints){
+        // Rigid, since both the bind matrix and the overall transformation
+        // are products of translations and rotations
+        glm::mat4 skin = j->bind * j->getOverallTransformation();
+        glm::vec4 *texel = &staged[j->iD * texels];
+        if (mode == MATRICES){
+            for (int c = 0; c < 4; c++){
+                texel[c] = skin[c];
+            }
+        } else {
+            glm::dualquat dq(glm::quat_cast(glm::mat3(skin)), glm::vec3(skin[3]));
+            texel[0] = glm::vec4(dq.real.x, dq.real.y, dq.real.z, dq.real.w);
+            texel[1] = glm::vec4(dq.dual.x, dq.dual.y, dq.dual.z, dq.dual.w);
+        }
+    }
+
+    if (generated && staged.size() == uploaded.size()
+            && std::memcmp(staged.data(), uploaded.data(), staged.size() * sizeof(glm::vec4)) == 0){
+        return false;
+    }
+    uploaded.swap(staged);
+    slotCount = jointSlots;
+
+    if (!generated){
+        context->glGenBuffers(1, &buf);
+        context->glGenTextures(1, &tex);
+        generated = true;
+    }
+
+    // The buffer is only reallocated when the skeleton outgrows it
+    int bytes = uploaded.size() * sizeof(glm::vec4);
+    context->glBindBuffer(GL_TEXTURE_BUFFER, buf);
+    if (bytes > capacity){
+        context->glBufferData(GL_TEXTURE_BUFFER, bytes, uploaded.data(), GL_DYNAMIC_DRAW);
+        capacity = bytes;
+        context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+        context->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buf);
+    } else if (bytes > 0){
+        context->glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, uploaded.data());
+    }
+    return true;
+}
+
+void SkinPalette::bind()
+{
+    if (!generated){
+        return;
+    }
+    context->glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    context->glBindTexture(GL_TEXTURE_BUFFER, tex);
+    context->glActiveTexture(GL_TEXTURE0);
+}
+
+void SkinPalette::destroy()
+{
+    if (generated){
+        context->glDeleteBuffers(1, &buf);
+        context->glDeleteTextures(1, &tex);
+    }
+    generated = false;
+    capacity = 0;
+    slotCount = 0;
+    uploaded.clear();
+}
+
+int SkinPalette::jointCount()
+{
+    return slotCount;
+}
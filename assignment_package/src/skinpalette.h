@@ -0,0 +1,61 @@
+#ifndef SKINPALETTE_H
+#define SKINPALETTE_H
+
+#include <openglcontext.h>
+#include <joint.h>
+#include <la.h>
+#include <vector>
+
+// The skinning transform of every joint (its bind matrix times its overall
+// transformation, combined once per joint on the CPU), kept in a texture
+// buffer that mesh.vert.glsl reads with texelFetch. Unlike a uniform array
+// it's sized to the skeleton instead of a fixed joint count, and it's only
+// uploaded again when one of the transforms changed.
+class SkinPalette
+{
+public:
+    enum Mode {
+        MATRICES,         // a mat4 per joint, four texels
+        DUAL_QUATERNIONS  // the real and dual parts of a unit dual quaternion per joint, two texels
+    };
+
+private:
+    OpenGLContext *context;
+
+    GLuint buf;
+    GLuint tex;
+    bool generated;
+    int capacity; // bytes allocated for buf
+    int slotCount; // joint slots in the last upload
+
+    // The texels of the joint with iD i start at i * texelsPerJoint(). staged
+    // is filled on every update() and only swapped in (and uploaded) if it
+    // differs from uploaded.
+    std::vector<glm::vec4> uploaded;
+    std::vector<glm::vec4> staged;
+
+public:
+    // The texture unit the shaders' u_Palette sampler reads from
+    static const int TEXTURE_UNIT = 1;
+
+    SkinPalette(OpenGLContext *context);
+
+    // Takes effect on the next update()
+    Mode mode;
+
+    int texelsPerJoint();
+
+    // Gathers the transforms of joints and uploads them if any of them
+    // changed since the last call. Returns whether an upload happened.
+    bool update(const std::vector<Joint*> &joints);
+
+    // Binds the palette to TEXTURE_UNIT
+    void bind();
+
+    void destroy();
+
+    // Number of joint slots in the palette (the highest joint iD plus one)
+    int jointCount();
+};
+
+#endif // SKINPALETTE_H
@@ -0,0 +1,169 @@
+#include "smoothing.h"
+#include <smartpointerhelp.h>
+#include <algorithm>
+
+LaplacianSmoother::LaplacianSmoother(Weighting weighting, float lambda, float mu)
+    : weighting(weighting), lambda(lambda), mu(mu), threadCount(0)
+{}
+
+// Cotangent of the angle at c in the triangle (a, b, c)
+static float cotangent(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 u = a - c;
+    glm::vec3 v = b - c;
+    float sin = glm::length(glm::cross(u, v));
+    if (sin < 1e-12f){
+        return 0.f;
+    }
+    return glm::dot(u, v) / sin;
+}
+
+// Half of the cotangent of the angle opposite e in its face, or -1 if the
+// face isn't a triangle (or there is no face) and the weight is undefined
+static float halfCotangent(HalfEdge *e)
+{
+    if (e->face == nullptr || e->next->next->next != e){
+        return -1.f;
+    }
+    return 0.5f * cotangent(e->sym->vert->pos, e->vert->pos, e->next->vert->pos);
+}
+
+// Lays the one-rings out as flat arrays indexed by vertex position in
+// mesh.vertices. Every half edge adds its endpoint to the ring of the vertex
+// it starts from, so the rings come straight out of the half edge list
+// without walking around each vertex.
+void LaplacianSmoother::buildOneRings(Mesh &mesh)
+{
+    int n = mesh.vertices.size();
+
+    // Vertex iDs are unique but can have gaps, so they're mapped to indices
+    // through a table instead of being used directly
+    unsigned int maxID = 0;
+    for (uPtr<Vertex> &v : mesh.vertices){
+        maxID = std::max(maxID, v->iD);
+    }
+    std::vector<int> indexOf(maxID + 1);
+    for (int i = 0; i < n; i++){
+        indexOf[mesh.vertPtr(i)->iD] = i;
+    }
+    auto index = [&](Vertex *v){ return indexOf[v->iD]; };
+
+    // Walks the half edges once, then buckets the (from, to, weight) triples by
+    // their starting vertex
+    std::vector<int> from;
+    std::vector<int> to;
+    std::vector<float> edgeWeights;
+    from.reserve(mesh.halfEdges.size());
+    to.reserve(mesh.halfEdges.size());
+    edgeWeights.reserve(mesh.halfEdges.size());
+    ringStart.assign(n + 1, 0);
+    pinned.assign(n, 0);
+    // Vertices with a non-triangle face in their one-ring fall back to uniform weights
+    std::vector<char> uniform(n, weighting == UNIFORM);
+    for (uPtr<HalfEdge> &e : mesh.halfEdges){
+        if (e->sym == nullptr){
+            continue;
+        }
+        int a = index(e->sym->vert);
+        from.push_back(a);
+        to.push_back(index(e->vert));
+        ringStart[a + 1]++;
+        if (e->face == nullptr || e->sym->face == nullptr){
+            pinned[a] = 1;
+        }
+        float w = 1.f;
+        if (weighting == COTANGENT){
+            float alpha = halfCotangent(e.get());
+            float beta = halfCotangent(e->sym);
+            if (alpha < 0.f || beta < 0.f){
+                uniform[a] = 1;
+            } else {
+                // Obtuse triangles can give negative weights, which make the
+                // smoothing unstable, so they're clamped to zero
+                w = std::max(alpha + beta, 0.f);
+            }
+        }
+        edgeWeights.push_back(w);
+    }
+    for (int i = 0; i < n; i++){
+        ringStart[i + 1] += ringStart[i];
+        if (ringStart[i + 1] == ringStart[i]){
+            pinned[i] = 1;
+        }
+    }
+
+    ring.resize(ringStart[n]);
+    weights.resize(ringStart[n]);
+    std::vector<int> fill(ringStart.begin(), ringStart.end() - 1);
+    for (size_t j = 0; j < from.size(); j++){
+        int k = fill[from[j]]++;
+        ring[k] = to[j];
+        weights[k] = edgeWeights[j];
+    }
+
+    for (int i = 0; i < n; i++){
+        float sum = 0.f;
+        for (int k = ringStart[i]; k < ringStart[i + 1]; k++){
+            sum += weights[k];
+        }
+        bool useUniform = uniform[i] || sum < 1e-8f;
+        int valence = ringStart[i + 1] - ringStart[i];
+        for (int k = ringStart[i]; k < ringStart[i + 1]; k++){
+            weights[k] = useUniform ? 1.f / valence : weights[k] / sum;
+        }
+    }
+}
+
+void LaplacianSmoother::pass(RangeWorkers &workers, const std::vector<glm::vec3> &src, std::vector<glm::vec3> &dst, float factor)
+{
+    workers.run([&](int begin, int end){
+        for (int v = begin; v < end; v++){
+            if (pinned[v]){
+                dst[v] = src[v];
+                continue;
+            }
+            glm::vec3 laplacian(0.f);
+            for (int k = ringStart[v]; k < ringStart[v + 1]; k++){
+                laplacian += weights[k] * (src[ring[k]] - src[v]);
+            }
+            dst[v] = src[v] + factor * laplacian;
+        }
+    });
+}
+
+// Each iteration is a shrinking pass with lambda followed by an inflating pass
+// with mu. Only the positions are touched, so the topology and the list items
+// stay valid.
+void LaplacianSmoother::smooth(Mesh &mesh, int iterations)
+{
+    int n = mesh.vertices.size();
+    if (n == 0 || iterations <= 0){
+        return;
+    }
+
+    // The weights are computed once from the starting shape and reused for
+    // every iteration
+    buildOneRings(mesh);
+
+    std::vector<glm::vec3> front(n);
+    std::vector<glm::vec3> back(n);
+    for (int i = 0; i < n; i++){
+        front[i] = mesh.vertPtr(i)->pos;
+    }
+
+    // Every pass is split the same way, so the threads are started once for
+    // all of them. Small meshes aren't worth more than one.
+    RangeWorkers workers(n, 4096, threadCount);
+    for (int i = 0; i < iterations; i++){
+        pass(workers, front, back, lambda);
+        front.swap(back);
+        if (mu != 0.f){
+            pass(workers, front, back, mu);
+            front.swap(back);
+        }
+    }
+
+    for (int i = 0; i < n; i++){
+        mesh.vertPtr(i)->pos = front[i];
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef SMOOTHING_H
+#define SMOOTHING_H
+
+#include <mesh.h>
+#include <parallel.h>
+#include <vector>
+
+// Laplacian smoothing over the one-rings of the half-edge mesh, with Taubin's
+// lambda/mu scheme to keep the mesh from shrinking. Positions are smoothed into
+// a second buffer on every pass, and each pass is split into contiguous vertex
+// ranges that run on separate threads, started once per smooth().
+class LaplacianSmoother
+{
+public:
+    enum Weighting {
+        UNIFORM,    // every neighbour counts the same
+        COTANGENT   // neighbours are weighted by the cotangents of the opposite angles
+    };
+
+    LaplacianSmoother(Weighting weighting = UNIFORM, float lambda = 0.5f, float mu = -0.53f);
+
+    Weighting weighting;
+
+    // The positive shrinking step and the negative inflating step of each
+    // iteration. Setting mu to 0 gives plain Laplacian smoothing.
+    float lambda;
+    float mu;
+
+    // Number of threads a pass is split over; 0 uses one per hardware thread
+    int threadCount;
+
+    // Smooths the vertex positions of mesh in place. Boundary vertices stay put.
+    void smooth(Mesh &mesh, int iterations);
+
+private:
+    // The neighbours of vertex v are ring[ringStart[v]] to ring[ringStart[v + 1] - 1],
+    // with matching normalized weights in weights
+    std::vector<int> ringStart;
+    std::vector<int> ring;
+    std::vector<float> weights;
+
+    // Vertices that aren't moved (boundary vertices and isolated ones)
+    std::vector<char> pinned;
+
+    // Builds the one-rings and their weights from the current positions
+    void buildOneRings(Mesh &mesh);
+
+    // One pass: dst = src + factor * L(src), split over workers
+    void pass(RangeWorkers &workers, const std::vector<glm::vec3> &src, std::vector<glm::vec3> &dst, float factor);
+};
+
+#endif // SMOOTHING_H
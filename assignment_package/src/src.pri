@@ -2,6 +2,21 @@ INCLUDEPATH += $$PWD
 DEPENDPATH += $$PWD
 
 SOURCES += \
+    $$PWD/adaptivesubdivision.cpp \
+    $$PWD/smoothing.cpp \
+    $$PWD/decimation.cpp \
+    $$PWD/meshbufferbuilder.cpp \
+    $$PWD/skinpalette.cpp \
+    $$PWD/frameconstants.cpp \
+    $$PWD/shadervariants.cpp \
+    $$PWD/jointgizmos.cpp \
+    $$PWD/programcache.cpp \
+    $$PWD/meshclusters.cpp \
+    $$PWD/meshoverlay.cpp \
+    $$PWD/antialiasing.cpp \
+    $$PWD/streambuffer.cpp \
+    $$PWD/meshscene.cpp \
+    $$PWD/bufferuploader.cpp \
     $$PWD/face.cpp \
     $$PWD/facedisplay.cpp \
     $$PWD/halfedge.cpp \
@@ -23,6 +38,22 @@ SOURCES += \
     $$PWD/vertexdisplay.cpp
 
 HEADERS += \
+    $$PWD/adaptivesubdivision.h \
+    $$PWD/smoothing.h \
+    $$PWD/decimation.h \
+    $$PWD/meshbufferbuilder.h \
+    $$PWD/skinpalette.h \
+    $$PWD/frameconstants.h \
+    $$PWD/shadervariants.h \
+    $$PWD/jointgizmos.h \
+    $$PWD/programcache.h \
+    $$PWD/meshclusters.h \
+    $$PWD/meshoverlay.h \
+    $$PWD/antialiasing.h \
+    $$PWD/streambuffer.h \
+    $$PWD/meshscene.h \
+    $$PWD/bufferuploader.h \
+    $$PWD/parallel.h \
     $$PWD/face.h \
     $$PWD/facedisplay.h \
     $$PWD/halfedge.h \
@@ -0,0 +1,155 @@
+#include "streambuffer.h"
+#include <QOpenGLContext>
+#include <iostream>
+#include <algorithm>
+
+// ARB_buffer_storage, newer than the headers may be
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+StreamBuffer::StreamBuffer(OpenGLContext *context)
+    : stalls(0), context(context), bufferStorage(nullptr), resolved(false), target(GL_ARRAY_BUFFER),
+      buf(0), regionBytes(0), unit(1), current(0), mappedBytes(0), fences(),
+      persistentMemory(nullptr), staging(), staged(false)
+{}
+
+void *StreamBuffer::map(GLenum t, int bytes, int u)
+{
+    if (!resolved){
+        QOpenGLContext *ctx = context->context();
+        if (ctx->format().version() >= qMakePair(4, 4)
+                || ctx->hasExtension("GL_ARB_buffer_storage")){
+            bufferStorage = reinterpret_cast<BufferStorage>(ctx->getProcAddress("glBufferStorage"));
+        }
+        resolved = true;
+    }
+
+    // Regions are never empty, so even no data gets a region of its own
+    int needed = std::max(1, (bytes + u - 1) / u) * u;
+    if (!buf || t != target || u != unit || needed > regionBytes){
+        target = t;
+        unit = u;
+        // Room to grow, so a few more vertices don't reallocate every time
+        allocate(std::max(needed, regionBytes + regionBytes / 2));
+    }
+
+    current = (current + 1) % REGIONS;
+    if (fences[current]){
+        GLenum status = context->glClientWaitSync(fences[current], 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED){
+            stalls++;
+            do {
+                status = context->glClientWaitSync(fences[current], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        context->glDeleteSync(fences[current]);
+        fences[current] = 0;
+    }
+
+    mappedBytes = bytes;
+    staged = false;
+    int offset = current * regionBytes;
+    if (persistentMemory){
+        return persistentMemory + offset;
+    }
+
+    context->glBindBuffer(target, buf);
+    void *memory = context->glMapBufferRange(target, offset, regionBytes,
+                                             GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!memory){
+        staging.resize(regionBytes);
+        staged = true;
+        memory = staging.data();
+    }
+    return memory;
+}
+
+int StreamBuffer::unmap()
+{
+    int offset = current * regionBytes;
+    if (staged){
+        context->glBindBuffer(target, buf);
+        context->glBufferSubData(target, offset, mappedBytes, staging.data());
+    } else if (!persistentMemory){
+        context->glBindBuffer(target, buf);
+        context->glUnmapBuffer(target);
+    }
+    return offset / unit;
+}
+
+void StreamBuffer::fence()
+{
+    if (!buf){
+        return;
+    }
+    if (fences[current]){
+        context->glDeleteSync(fences[current]);
+    }
+    fences[current] = context->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLuint StreamBuffer::buffer() const
+{
+    return buf;
+}
+
+bool StreamBuffer::persistent() const
+{
+    return persistentMemory != nullptr;
+}
+
+void StreamBuffer::allocate(int bytes)
+{
+    // The old buffer is only freed by the driver once the draws reading it
+    // are done, so its fences aren't needed
+    release();
+    regionBytes = (bytes + unit - 1) / unit * unit;
+    current = REGIONS - 1;
+
+    int size = REGIONS * regionBytes;
+    context->glGenBuffers(1, &buf);
+    context->glBindBuffer(target, buf);
+    if (bufferStorage){
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        bufferStorage(target, size, nullptr, flags);
+        persistentMemory = static_cast<char*>(context->glMapBufferRange(target, 0, size, flags));
+        if (persistentMemory){
+            return;
+        }
+        // Immutable storage can't be given glBufferData, so the buffer is
+        // made again for mapping region by region
+        std::cerr << "Could not map a stream buffer persistently, mapping every frame instead" << std::endl;
+        bufferStorage = nullptr;
+        context->glDeleteBuffers(1, &buf);
+        context->glGenBuffers(1, &buf);
+        context->glBindBuffer(target, buf);
+    }
+    context->glBufferData(target, size, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::release()
+{
+    for (GLsync &f : fences){
+        if (f){
+            context->glDeleteSync(f);
+            f = 0;
+        }
+    }
+    if (persistentMemory){
+        context->glBindBuffer(target, buf);
+        context->glUnmapBuffer(target);
+        persistentMemory = nullptr;
+    }
+    context->glDeleteBuffers(1, &buf);
+    buf = 0;
+    regionBytes = 0;
+}
+
+void StreamBuffer::destroy()
+{
+    release();
+}
@@ -0,0 +1,77 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <openglcontext.h>
+#include <vector>
+
+// A buffer for data the CPU writes again every frame, or nearly, split into
+// REGIONS regions used in turn. Each frame's data goes into the next region,
+// straight into mapped memory, while the GPU may still be reading the ones
+// before it; a fence placed after the draws that read a region is all that's
+// waited on before writing it again, and with three regions that is a frame
+// the GPU finished long ago. glBufferData would have the driver allocate new
+// storage on every upload, and glBufferSubData can stall until the draws of
+// the last frame are done.
+//
+// With OpenGL 4.4 or ARB_buffer_storage (resolved from the context, as the
+// 3.2 Core functions don't have glBufferStorage) the whole buffer is mapped
+// once, persistently and coherently. Otherwise every region is mapped with
+// glMapBufferRange, unsynchronized since the fence already kept it safe and
+// invalidated since every byte of it is written again.
+class StreamBuffer
+{
+public:
+    static const int REGIONS = 3;
+
+    StreamBuffer(OpenGLContext *context);
+
+    // Moves on to the next region and returns where to write bytes bytes
+    // into it, only waiting if the GPU is still reading that region. Every
+    // region starts at a multiple of unit bytes, so offsets can be given in
+    // whole vertices or texels. The buffer is reallocated, under a new name,
+    // if the regions are too small. Needs a current context.
+    void *map(GLenum target, int bytes, int unit);
+
+    // Ends the writes made through the last map(), and returns the offset of
+    // its region in units
+    int unmap();
+
+    // Fences the region last mapped, after the draws that read it were issued
+    void fence();
+
+    GLuint buffer() const;
+
+    // Whether the buffer is mapped persistently, rather than region by region
+    bool persistent() const;
+
+    // Times map() had to wait for the GPU, which more regions would avoid
+    int stalls;
+
+    void destroy();
+
+private:
+    typedef void (QOPENGLF_APIENTRYP BufferStorage)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+    OpenGLContext *context;
+    BufferStorage bufferStorage;
+    bool resolved; // whether bufferStorage was looked up yet
+
+    GLenum target;
+    GLuint buf;
+    int regionBytes;
+    int unit;
+    int current;    // the region last mapped
+    int mappedBytes;
+    GLsync fences[REGIONS];
+
+    char *persistentMemory; // the whole buffer, while it's mapped persistently
+    // Where map() has the writes made if glMapBufferRange fails, which
+    // unmap() copies in with glBufferSubData instead
+    std::vector<char> staging;
+    bool staged;
+
+    void allocate(int bytes);
+    void release();
+};
+
+#endif // STREAMBUFFER_H
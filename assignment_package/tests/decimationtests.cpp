@@ -0,0 +1,96 @@
+#include "tests.h"
+#include "testmesh.h"
+#include <decimation.h>
+#include <cassert>
+#include <map>
+#include <utility>
+
+// Checks what the link and flip conditions of QuadricDecimator::canCollapse
+// guarantee for a closed mesh around the origin that's convex: every edge
+// still has exactly two triangles, wound opposite ways, so the surface stays
+// closed and manifold; the genus is kept (V - E + F = 2); and no triangle
+// is degenerate or turned inside out.
+static void checkDecimated(LODMesh &lod)
+{
+    int triangles = lod.faceCount();
+    assert(int(lod.tris.size()) == 3 * triangles);
+    assert(int(lod.colours.size()) == triangles);
+
+    std::map<std::pair<GLuint, GLuint>, int> directed;
+    for (int t = 0; t < triangles; t++){
+        GLuint c[3] = {lod.tris[3 * t], lod.tris[3 * t + 1], lod.tris[3 * t + 2]};
+        for (int k = 0; k < 3; k++){
+            assert(c[k] < lod.verts.size());
+            assert(c[k] != c[(k + 1) % 3]);
+            directed[std::make_pair(c[k], c[(k + 1) % 3])]++;
+        }
+    }
+    for (const auto &edge : directed){
+        assert(edge.second == 1);
+        assert(directed.count(std::make_pair(edge.first.second, edge.first.first)) == 1);
+    }
+    int edges = directed.size() / 2;
+    assert(int(lod.verts.size()) - edges + triangles == 2);
+
+    // All wound the same way relative to the outside, whichever way that is
+    int outward = 0;
+    for (int t = 0; t < triangles; t++){
+        const glm::vec3 &a = lod.verts[lod.tris[3 * t]];
+        const glm::vec3 &b = lod.verts[lod.tris[3 * t + 1]];
+        const glm::vec3 &c = lod.verts[lod.tris[3 * t + 2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        assert(glm::length(normal) > 0.f);
+        outward += glm::dot(normal, a + b + c) > 0.f ? 1 : -1;
+    }
+    assert(outward == triangles || outward == -triangles);
+}
+
+void testDecimation()
+{
+    // Never created on the GPU, and left allocated (see loadOBJ)
+    LODMesh *lod = new LODMesh(nullptr);
+
+    // Any collapse of a tetrahedron would leave two triangles glued back to
+    // back, so none is allowed
+    Mesh *tetrahedron = loadOBJ("decimation_tetrahedron.obj", TETRAHEDRON_OBJ);
+    QuadricDecimator tetrahedronDecimator(*tetrahedron);
+    assert(tetrahedronDecimator.faceCount() == 4);
+    assert(tetrahedronDecimator.decimateTo(0) == 4);
+    tetrahedronDecimator.extract(*lod);
+    checkDecimated(*lod);
+
+    // The quads and pentagons are fanned into triangles first
+    Mesh *prism = loadOBJ("decimation_prism.obj", PRISM_OBJ);
+    QuadricDecimator prismDecimator(*prism);
+    assert(prismDecimator.faceCount() == 2 * 3 + 5 * 2);
+    prismDecimator.decimateTo(4);
+    prismDecimator.extract(*lod);
+    checkDecimated(*lod);
+
+    // The flat sides give a tie between collapses that cost nothing, and
+    // moving a vertex onto a neighbour across a ring that has gone concave
+    // would fold a triangle over; only the flip condition stops that
+    Mesh *grid = loadOBJ("decimation_grid.obj", gridCubeOBJ(8));
+    QuadricDecimator gridDecimator(*grid);
+    int squares = gridDecimator.faceCount();
+    assert(squares == 6 * 8 * 8 * 2);
+    for (int goal : {squares / 2, squares / 4, squares / 16, 12}){
+        assert(gridDecimator.decimateTo(goal) <= goal);
+        gridDecimator.extract(*lod);
+        checkDecimated(*lod);
+    }
+
+    // Taken down in steps, as LODChain does, checking every level
+    Mesh *sphere = loadOBJ("decimation_sphere.obj", sphereOBJ(16, 32));
+    QuadricDecimator sphereDecimator(*sphere);
+    int faces = sphereDecimator.faceCount();
+    assert(faces == 2 * 32 + 14 * 32 * 2);
+    for (int goal : {faces / 2, faces / 8, faces / 32, 8}){
+        int reached = sphereDecimator.decimateTo(goal);
+        assert(reached == sphereDecimator.faceCount());
+        assert(reached <= goal || goal == 8);
+        sphereDecimator.extract(*lod);
+        checkDecimated(*lod);
+        assert(lod->faceCount() == reached);
+    }
+}
@@ -0,0 +1,25 @@
+#include "tests.h"
+#include <QApplication>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    // MyGL is a widget, so the subdivision checks need an application. It's
+    // never shown, and nothing in here needs an OpenGL context.
+    QApplication a(argc, argv);
+
+    std::cout << "Subdivision" << std::endl;
+    testSubdivision();
+
+    std::cout << "Decimation" << std::endl;
+    testDecimation();
+
+    std::cout << "Mesh buffers" << std::endl;
+    testMeshBufferBuilder();
+
+    std::cout << "Mesh clusters" << std::endl;
+    testMeshClusters();
+
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
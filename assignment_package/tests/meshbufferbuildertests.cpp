@@ -0,0 +1,161 @@
+#include "tests.h"
+#include "testmesh.h"
+#include <meshbufferbuilder.h>
+#include <halfedge.h>
+#include <cassert>
+#include <cstring>
+
+// The corners of f, starting at f->edge as the builder does
+static std::vector<Vertex*> corners(Face *f)
+{
+    std::vector<Vertex*> out;
+    HalfEdge *e = f->edge;
+    do {
+        out.push_back(e->vert);
+        e = e->next;
+    } while (e != f->edge);
+    return out;
+}
+
+// Checks the prefix sums over the valences of the faces in every slot, and
+// that each slot's triangles are a fan over its face
+static void checkSlots(MeshBufferBuilder &b, Mesh &mesh)
+{
+    int faceCount = mesh.faces.size();
+    int cornerCount = 0;
+    for (int f = 0; f < faceCount; f++){
+        Face *face = b.faceAt(mesh.faces, f);
+        std::vector<Vertex*> c = corners(face);
+        int n = c.size();
+        assert(b.faceIndex(mesh.faces, face) == f);
+        assert(b.firstCorner(f) == cornerCount);
+        assert(b.firstCorner(f + 1) - b.firstCorner(f) == n);
+        assert(b.firstTriangle(f + 1) - b.firstTriangle(f) == n - 2);
+        cornerCount += n;
+
+        const GLuint *tri = &b.idx[3 * b.firstTriangle(f)];
+        for (int i = 1; i < n - 1; i++){
+            if (b.mode == MeshBufferBuilder::SHARED_VERTICES){
+                assert(int(tri[0]) == b.vertexIndex(mesh.vertices, c[0]));
+                assert(int(tri[1]) == b.vertexIndex(mesh.vertices, c[i]));
+                assert(int(tri[2]) == b.vertexIndex(mesh.vertices, c[i + 1]));
+                assert(b.faceCols[b.firstTriangle(f) + i - 1] == packColour(face->colour));
+            } else {
+                int first = b.firstCorner(f);
+                assert(int(tri[0]) == first);
+                assert(int(tri[1]) == first + i);
+                assert(int(tri[2]) == first + i + 1);
+            }
+            tri += 3;
+        }
+        if (b.mode == MeshBufferBuilder::FACE_CORNERS){
+            for (int i = 0; i < n; i++){
+                assert(b.vertex(b.firstCorner(f) + i).pos == c[i]->pos);
+                assert(b.vertex(b.firstCorner(f) + i).col == packColour(face->colour));
+            }
+        }
+    }
+    assert(b.firstCorner(faceCount) == cornerCount);
+    assert(int(b.idx.size()) == 3 * (cornerCount - 2 * faceCount));
+
+    if (b.mode == MeshBufferBuilder::SHARED_VERTICES){
+        assert(b.vertexCount() == int(mesh.vertices.size()));
+        assert(int(b.faceCols.size()) == cornerCount - 2 * faceCount);
+        for (int i = 0; i < b.vertexCount(); i++){
+            assert(b.position(i) == mesh.vertices[i]->pos);
+        }
+    } else {
+        assert(b.vertexCount() == cornerCount);
+        assert(b.faceCols.empty());
+    }
+}
+
+static void assertSameBuild(MeshBufferBuilder &a, MeshBufferBuilder &b)
+{
+    assert(a.verts.size() == b.verts.size());
+    assert(std::memcmp(a.verts.data(), b.verts.data(), a.verts.size()) == 0);
+    assert(a.idx == b.idx);
+    assert(a.faceCols == b.faceCols);
+}
+
+// The fills for pure triangle and pure quad meshes must write exactly what
+// the general one does
+static void checkFixedArity(Mesh &mesh, int arity, int threadCount)
+{
+    for (MeshBufferBuilder::Layout layout : {MeshBufferBuilder::SHARED_VERTICES, MeshBufferBuilder::FACE_CORNERS}){
+        MeshBufferBuilder fixed, general;
+        fixed.threadCount = general.threadCount = threadCount;
+        general.fixedArity = false;
+        fixed.build(mesh.faces, mesh.vertices, layout, true, false);
+        general.build(mesh.faces, mesh.vertices, layout, true, false);
+        assert(fixed.fillArity() == arity);
+        assert(general.fillArity() == 0);
+        checkSlots(fixed, mesh);
+        assertSameBuild(fixed, general);
+    }
+}
+
+void testMeshBufferBuilder()
+{
+    // 2 pentagons and 5 quads: 30 corners and 16 triangles
+    Mesh *prism = loadOBJ("buffers_prism.obj", PRISM_OBJ);
+    for (uPtr<Face> &f : prism->faces){
+        f->colour = glm::vec3(f->iD % 3, f->iD % 2, 0.5f);
+    }
+    MeshBufferBuilder b;
+    b.threadCount = 1;
+    for (MeshBufferBuilder::Layout layout : {MeshBufferBuilder::SHARED_VERTICES, MeshBufferBuilder::FACE_CORNERS}){
+        b.build(prism->faces, prism->vertices, layout, true, false);
+        assert(b.firstCorner(prism->faces.size()) == 30);
+        assert(b.idx.size() == 3 * 16);
+        checkSlots(b, *prism);
+
+        // The same faces laid out backwards
+        std::vector<int> order;
+        for (int f = prism->faces.size() - 1; f >= 0; f--){
+            order.push_back(f);
+        }
+        b.build(prism->faces, prism->vertices, layout, true, false, order);
+        for (size_t f = 0; f < order.size(); f++){
+            assert(b.faceAt(prism->faces, f) == prism->faces[order[f]].get());
+        }
+        checkSlots(b, *prism);
+    }
+
+    // A recoloured face is written back into its own slots only
+    b.build(prism->faces, prism->vertices, MeshBufferBuilder::SHARED_VERTICES, true, false);
+    std::vector<GLuint> before = b.faceCols;
+    Face *pentagon = nullptr;
+    for (uPtr<Face> &f : prism->faces){
+        if (corners(f.get()).size() == 5){
+            pentagon = f.get();
+        }
+    }
+    int slot = b.faceIndex(prism->faces, pentagon);
+    pentagon->colour = glm::vec3(1.f, 0.f, 1.f);
+    assert(b.refillFaces(prism->faces, {slot}));
+    for (int t = 0; t < int(before.size()); t++){
+        bool inside = t >= b.firstTriangle(slot) && t < b.firstTriangle(slot + 1);
+        assert(b.faceCols[t] == (inside ? packColour(pentagon->colour) : before[t]));
+    }
+
+    // Pure triangles, pure quads, a mix, and quads over several threads
+    checkFixedArity(*loadOBJ("buffers_tetrahedron.obj", TETRAHEDRON_OBJ), 3, 1);
+    checkFixedArity(*loadOBJ("buffers_cube.obj", CUBE_OBJ), 4, 1);
+    checkFixedArity(*prism, 0, 1);
+    checkFixedArity(*loadOBJ("buffers_grid.obj", gridCubeOBJ(60)), 4, 4);
+
+    // Big enough to be split over several threads, which must write exactly
+    // what one thread does
+    Mesh *sphere = loadOBJ("buffers_sphere.obj", sphereOBJ(130, 160));
+    assert(sphere->faces.size() > 16384);
+    for (MeshBufferBuilder::Layout layout : {MeshBufferBuilder::SHARED_VERTICES, MeshBufferBuilder::FACE_CORNERS}){
+        MeshBufferBuilder one, many;
+        one.threadCount = 1;
+        many.threadCount = 4;
+        one.build(sphere->faces, sphere->vertices, layout, true, false);
+        many.build(sphere->faces, sphere->vertices, layout, true, false);
+        checkSlots(many, *sphere);
+        assertSameBuild(one, many);
+    }
+}
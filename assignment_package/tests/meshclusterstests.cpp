@@ -0,0 +1,73 @@
+#include "tests.h"
+#include "testmesh.h"
+#include <meshclusters.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+static bool isPermutation(std::vector<int> order, int count)
+{
+    std::sort(order.begin(), order.end());
+    for (int i = 0; i < count; i++){
+        if (i >= int(order.size()) || order[i] != i){
+            return false;
+        }
+    }
+    return int(order.size()) == count;
+}
+
+void testMeshClusters()
+{
+    // With a cache that holds the whole mesh, every vertex is transformed
+    // exactly once, whatever the order
+    MeshClusters c;
+    Mesh *tetrahedron = loadOBJ("clusters_tetrahedron.obj", TETRAHEDRON_OBJ);
+    assert(std::abs(c.acmr(tetrahedron->faces, {}) - 4.f / 4.f) < 1e-6f);
+    assert(std::abs(c.acmr(tetrahedron->faces, {3, 1, 0, 2}) - 4.f / 4.f) < 1e-6f);
+    Mesh *cube = loadOBJ("clusters_cube.obj", CUBE_OBJ);
+    assert(std::abs(c.acmr(cube->faces, {}) - 8.f / 12.f) < 1e-6f);
+
+    // A mesh much bigger than the cache, cut into several clusters
+    Mesh *sphere = loadOBJ("clusters_sphere.obj", sphereOBJ(48, 64));
+    int faceCount = sphere->faces.size();
+    c.targetTriangles = 256;
+    c.threadCount = 1;
+    c.sort(sphere->faces);
+    assert(isPermutation(c.order, faceCount));
+    std::vector<int> sorted = c.order;
+    float sortedACMR = c.acmr(sphere->faces, sorted);
+
+    c.reorder(sphere->faces);
+    assert(isPermutation(c.order, faceCount));
+    float reorderedACMR = c.acmr(sphere->faces, c.order);
+    assert(reorderedACMR < sortedACMR);
+    // Every vertex at least once, and never more than three per triangle
+    int triangles = 2 * 64 + 46 * 64 * 2;
+    assert(reorderedACMR >= float(sphere->vertices.size()) / triangles);
+    assert(reorderedACMR <= 3.f);
+
+    // reorder() only moves faces within the runs split() makes clusters of,
+    // so every cluster holds the same faces as it would have unreordered
+    MeshBufferBuilder b;
+    b.threadCount = 1;
+    b.build(sphere->faces, sphere->vertices, MeshBufferBuilder::SHARED_VERTICES, true, false, c.order);
+    c.split(b, sphere->faces);
+    assert(c.clusters.size() > 1);
+    assert(c.clusters.front().firstSlot == 0);
+    assert(c.clusters.back().endSlot == faceCount);
+    int triangleCount = 0;
+    for (size_t i = 0; i < c.clusters.size(); i++){
+        const MeshClusters::Cluster &cluster = c.clusters[i];
+        assert(i == 0 || cluster.firstSlot == c.clusters[i - 1].endSlot);
+        assert(cluster.firstTriangle == b.firstTriangle(cluster.firstSlot));
+        assert(cluster.triangleCount == b.firstTriangle(cluster.endSlot) - cluster.firstTriangle);
+        triangleCount += cluster.triangleCount;
+
+        std::vector<int> before(sorted.begin() + cluster.firstSlot, sorted.begin() + cluster.endSlot);
+        std::vector<int> after(c.order.begin() + cluster.firstSlot, c.order.begin() + cluster.endSlot);
+        std::sort(before.begin(), before.end());
+        std::sort(after.begin(), after.end());
+        assert(before == after);
+    }
+    assert(triangleCount == triangles);
+}
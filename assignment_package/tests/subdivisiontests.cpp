@@ -0,0 +1,105 @@
+#include "tests.h"
+#include "testmesh.h"
+#include <mygl.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+// A cube and a tetrahedron ten units along x, which mixes quads with
+// triangles, so catmullClark() takes the general step for both
+static const char *CUBE_AND_TETRAHEDRON_OBJ =
+        "v -0.5 -0.5 0.5\n"
+        "v 0.5 -0.5 0.5\n"
+        "v -0.5 0.5 0.5\n"
+        "v 0.5 0.5 0.5\n"
+        "v -0.5 0.5 -0.5\n"
+        "v 0.5 0.5 -0.5\n"
+        "v -0.5 -0.5 -0.5\n"
+        "v 0.5 -0.5 -0.5\n"
+        "v 11 1 1\n"
+        "v 11 -1 -1\n"
+        "v 9 1 -1\n"
+        "v 9 -1 1\n"
+        "f 1 2 4 3\n"
+        "f 3 4 6 5\n"
+        "f 5 6 8 7\n"
+        "f 7 8 2 1\n"
+        "f 2 8 6 4\n"
+        "f 7 1 3 5\n"
+        "f 9 10 11\n"
+        "f 9 11 12\n"
+        "f 9 12 10\n"
+        "f 10 12 11\n";
+
+static const glm::vec3 TETRAHEDRON_OFFSET(10.f, 0.f, 0.f);
+
+// The positions of the vertices on one side of x = 5, moved by offset and
+// sorted, so meshes built in different orders can be compared
+static std::vector<glm::vec3> sortedPositions(Mesh &mesh, bool far, const glm::vec3 &offset)
+{
+    std::vector<glm::vec3> positions;
+    for (uPtr<Vertex> &v : mesh.vertices){
+        if ((v->pos.x > 5.f) == far){
+            positions.push_back(v->pos + offset);
+        }
+    }
+    std::sort(positions.begin(), positions.end(), [](const glm::vec3 &a, const glm::vec3 &b){
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    });
+    return positions;
+}
+
+static void assertSamePositions(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b)
+{
+    assert(a.size() == b.size());
+    for (size_t i = 0; i < a.size(); i++){
+        assert(glm::length(a[i] - b[i]) < 1e-5f);
+    }
+}
+
+static void assertCounts(Mesh &mesh, size_t vertices, size_t faces, size_t halfEdges)
+{
+    assert(mesh.vertices.size() == vertices);
+    assert(mesh.faces.size() == faces);
+    assert(mesh.halfEdges.size() == halfEdges);
+}
+
+void testSubdivision()
+{
+    // Never shown, so it never gets a context to create buffers with or to
+    // destroy them; it's left allocated
+    MyGL *gl = new MyGL(nullptr);
+    Mesh &mesh = *gl->getMesh();
+
+    // Pure quads take catmullClarkStep<4>. Every step gives each edge a
+    // midpoint, each face a centroid and each corner a quad.
+    mesh.createFromOBJ(writeOBJ("subdivision_cube.obj", CUBE_OBJ));
+    assert(mesh.uniformArity() == 4);
+    gl->catmullClark();
+    checkHalfEdges(mesh);
+    assertCounts(mesh, 8 + 12 + 6, 24, 96);
+    std::vector<glm::vec3> cube = sortedPositions(mesh, false, glm::vec3(0.f));
+    gl->catmullClark();
+    checkHalfEdges(mesh);
+    assertCounts(mesh, 26 + 48 + 24, 96, 384);
+
+    // Pure triangles take catmullClarkStep<3>, and come out as quads
+    mesh.createFromOBJ(writeOBJ("subdivision_tetrahedron.obj", TETRAHEDRON_OBJ));
+    assert(mesh.uniformArity() == 3);
+    gl->catmullClark();
+    checkHalfEdges(mesh);
+    assertCounts(mesh, 4 + 6 + 4, 12, 48);
+    assert(mesh.uniformArity() == 4);
+    std::vector<glm::vec3> tetrahedron = sortedPositions(mesh, false, glm::vec3(0.f));
+    gl->catmullClark();
+    checkHalfEdges(mesh);
+
+    // The general step on the two together has to land on the same points
+    mesh.createFromOBJ(writeOBJ("subdivision_mixed.obj", CUBE_AND_TETRAHEDRON_OBJ));
+    assert(mesh.uniformArity() == 0);
+    gl->catmullClark();
+    checkHalfEdges(mesh);
+    assertCounts(mesh, 26 + 14, 24 + 12, 96 + 48);
+    assertSamePositions(sortedPositions(mesh, false, glm::vec3(0.f)), cube);
+    assertSamePositions(sortedPositions(mesh, true, -TETRAHEDRON_OFFSET), tetrahedron);
+}
@@ -0,0 +1,186 @@
+#include "testmesh.h"
+#include <utils.h>
+#include <QDir>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+const char *CUBE_OBJ =
+        "v -0.5 -0.5 0.5\n"
+        "v 0.5 -0.5 0.5\n"
+        "v -0.5 0.5 0.5\n"
+        "v 0.5 0.5 0.5\n"
+        "v -0.5 0.5 -0.5\n"
+        "v 0.5 0.5 -0.5\n"
+        "v -0.5 -0.5 -0.5\n"
+        "v 0.5 -0.5 -0.5\n"
+        "f 1 2 4 3\n"
+        "f 3 4 6 5\n"
+        "f 5 6 8 7\n"
+        "f 7 8 2 1\n"
+        "f 2 8 6 4\n"
+        "f 7 1 3 5\n";
+
+const char *TETRAHEDRON_OBJ =
+        "v 1 1 1\n"
+        "v 1 -1 -1\n"
+        "v -1 1 -1\n"
+        "v -1 -1 1\n"
+        "f 1 2 3\n"
+        "f 1 3 4\n"
+        "f 1 4 2\n"
+        "f 2 4 3\n";
+
+const char *PRISM_OBJ =
+        "v 1 0 -1\n"
+        "v 0.309017 0.951057 -1\n"
+        "v -0.809017 0.587785 -1\n"
+        "v -0.809017 -0.587785 -1\n"
+        "v 0.309017 -0.951057 -1\n"
+        "v 1 0 1\n"
+        "v 0.309017 0.951057 1\n"
+        "v -0.809017 0.587785 1\n"
+        "v -0.809017 -0.587785 1\n"
+        "v 0.309017 -0.951057 1\n"
+        "f 6 7 8 9 10\n"
+        "f 5 4 3 2 1\n"
+        "f 1 2 7 6\n"
+        "f 2 3 8 7\n"
+        "f 3 4 9 8\n"
+        "f 4 5 10 9\n"
+        "f 5 1 6 10\n";
+
+// Lists faces counter-clockwise seen from outside, as .obj files do, given
+// that the mesh is convex around the origin
+static std::string writeConvexOBJ(const std::vector<glm::vec3> &pos, std::vector<std::vector<int>> &faces)
+{
+    std::ostringstream obj;
+    for (const glm::vec3 &p : pos){
+        obj << "v " << p.x << " " << p.y << " " << p.z << "\n";
+    }
+    for (std::vector<int> &f : faces){
+        glm::vec3 normal(0.f);
+        glm::vec3 centre(0.f);
+        for (size_t k = 0; k < f.size(); k++){
+            normal += glm::cross(pos[f[k]], pos[f[(k + 1) % f.size()]]);
+            centre += pos[f[k]];
+        }
+        if (glm::dot(normal, centre) < 0.f){
+            std::reverse(f.begin(), f.end());
+        }
+        obj << "f";
+        for (int v : f){
+            obj << " " << v + 1;
+        }
+        obj << "\n";
+    }
+    return obj.str();
+}
+
+std::string sphereOBJ(int rings, int segments)
+{
+    std::vector<glm::vec3> pos;
+    pos.push_back(glm::vec3(0.f, 1.f, 0.f));
+    for (int i = 1; i < rings; i++){
+        float theta = PI * i / rings;
+        for (int j = 0; j < segments; j++){
+            float phi = 2.f * PI * j / segments;
+            pos.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+        }
+    }
+    pos.push_back(glm::vec3(0.f, -1.f, 0.f));
+    int south = pos.size() - 1;
+    auto ring = [segments](int i, int j){
+        return 1 + (i - 1) * segments + (j % segments);
+    };
+
+    std::vector<std::vector<int>> faces;
+    for (int j = 0; j < segments; j++){
+        faces.push_back({0, ring(1, j), ring(1, j + 1)});
+        for (int i = 1; i < rings - 1; i++){
+            faces.push_back({ring(i, j), ring(i + 1, j), ring(i + 1, j + 1), ring(i, j + 1)});
+        }
+        faces.push_back({south, ring(rings - 1, j + 1), ring(rings - 1, j)});
+    }
+    return writeConvexOBJ(pos, faces);
+}
+
+std::string gridCubeOBJ(int n)
+{
+    // The points of an (n + 1)^3 lattice that lie on the surface, shared by
+    // the sides that meet at them
+    std::vector<glm::vec3> pos;
+    std::vector<int> index((n + 1) * (n + 1) * (n + 1), -1);
+    auto point = [&](int x, int y, int z){
+        int &i = index[(x * (n + 1) + y) * (n + 1) + z];
+        if (i < 0){
+            i = pos.size();
+            pos.push_back(glm::vec3(x, y, z) * (2.f / n) - glm::vec3(1.f));
+        }
+        return i;
+    };
+
+    std::vector<std::vector<int>> faces;
+    for (int axis = 0; axis < 3; axis++){
+        for (int side : {0, n}){
+            for (int u = 0; u < n; u++){
+                for (int v = 0; v < n; v++){
+                    std::vector<int> quad;
+                    for (glm::ivec2 c : {glm::ivec2(u, v), glm::ivec2(u + 1, v), glm::ivec2(u + 1, v + 1), glm::ivec2(u, v + 1)}){
+                        glm::ivec3 p;
+                        p[axis] = side;
+                        p[(axis + 1) % 3] = c.x;
+                        p[(axis + 2) % 3] = c.y;
+                        quad.push_back(point(p.x, p.y, p.z));
+                    }
+                    faces.push_back(quad);
+                }
+            }
+        }
+    }
+    return writeConvexOBJ(pos, faces);
+}
+
+std::string writeOBJ(const std::string &name, const std::string &obj)
+{
+    std::string path = QDir::temp().filePath(QString::fromStdString(name)).toStdString();
+    std::ofstream file(path);
+    file << obj;
+    return path;
+}
+
+Mesh *loadOBJ(const std::string &name, const std::string &obj)
+{
+    Mesh *mesh = new Mesh(nullptr);
+    mesh->createFromOBJ(writeOBJ(name, obj));
+    return mesh;
+}
+
+void checkHalfEdges(Mesh &mesh)
+{
+    for (uPtr<HalfEdge> &e : mesh.halfEdges){
+        assert(e->next && e->sym && e->face && e->vert);
+        assert(e->sym->sym == e.get());
+        assert(e->sym->vert != e->vert);
+        assert(e->next->face == e->face);
+
+        // The edge before e in its face, which is where e starts
+        HalfEdge *prev = e.get();
+        bool reachesFace = false;
+        for (size_t i = 0; i <= mesh.halfEdges.size() && prev->next != e.get(); i++){
+            reachesFace = reachesFace || prev == e->face->edge;
+            prev = prev->next;
+        }
+        reachesFace = reachesFace || prev == e->face->edge;
+        assert(prev->next == e.get() && reachesFace);
+        assert(prev->vert == e->sym->vert);
+    }
+    for (uPtr<Vertex> &v : mesh.vertices){
+        assert(v->edge && v->edge->vert == v.get());
+    }
+    for (uPtr<Face> &f : mesh.faces){
+        assert(f->edge && f->edge->face == f.get());
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef TESTMESH_H
+#define TESTMESH_H
+
+#include <mesh.h>
+#include <string>
+
+// Small closed meshes as .obj text. Meshes with boundaries lose the syms of
+// their border edges in Mesh::mergeExtraneous, so none of them are open.
+extern const char *CUBE_OBJ;         // 8 vertices, 6 quads
+extern const char *TETRAHEDRON_OBJ;  // 4 vertices, 4 triangles
+extern const char *PRISM_OBJ;        // a pentagonal prism: 2 pentagons, 5 quads
+
+// A unit sphere cut into rings bands of latitude and segments of longitude:
+// triangles around the poles and quads in between, all facing outwards
+std::string sphereOBJ(int rings, int segments);
+
+// A cube from -1 to 1 with every side cut into n by n quads. The sides are
+// flat, so the quadrics of their edges are singular and collapsing one costs
+// nothing, whichever way it goes.
+std::string gridCubeOBJ(int n);
+
+// Writes obj to a file called name in the temporary directory and returns
+// its path, for Mesh::createFromOBJ
+std::string writeOBJ(const std::string &name, const std::string &obj);
+
+// Loads obj into a new Mesh. The mesh has no context, so it's never created
+// on the GPU, and it's never deleted either: Drawable's destructor would
+// delete its buffers through the context.
+Mesh *loadOBJ(const std::string &name, const std::string &obj);
+
+// Asserts that every half edge of a closed mesh is paired with its sym,
+// runs around a face that starts at one of its edges, and starts where the
+// edge before it ends, and that every vertex's edge points at it
+void checkHalfEdges(Mesh &mesh);
+
+#endif // TESTMESH_H
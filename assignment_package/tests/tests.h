@@ -0,0 +1,18 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+// Each group of checks, run in turn by main(). A failed check asserts.
+
+// The fixed-arity Catmull-Clark steps against the general one
+void testSubdivision();
+
+// What the link and flip conditions keep intact while decimating
+void testDecimation();
+
+// The prefix sums and fans MeshBufferBuilder lays its arrays out with
+void testMeshBufferBuilder();
+
+// The clusters' vertex cache reorder and the miss ratio it's measured by
+void testMeshClusters();
+
+#endif // TESTS_H
@@ -0,0 +1,54 @@
+# Checks of the CPU side of the mesh code, with plain asserts. Built against
+# the same sources as MicroMaya, minus its main window:
+#   qmake tests.pro && make && QT_QPA_PLATFORM=offscreen ./tests
+# It prints which group of checks runs, and aborts on the first that fails.
+QT += core widgets
+
+TARGET = tests
+TEMPLATE = app
+CONFIG += console
+CONFIG += c++1z
+win32 {
+    LIBS += -lopengl32
+    LIBS += -lglu32
+}
+CONFIG += warn_on
+# The checks are asserts, so NDEBUG must never be defined
+CONFIG += debug
+
+INCLUDEPATH += ../include
+
+include(../src/src.pri)
+
+SOURCES -= \
+    $$clean_path($$PWD/../src/main.cpp) \
+    $$clean_path($$PWD/../src/mainwindow.cpp) \
+    $$clean_path($$PWD/../src/cameracontrolshelp.cpp)
+
+HEADERS -= \
+    $$clean_path($$PWD/../src/mainwindow.h) \
+    $$clean_path($$PWD/../src/cameracontrolshelp.h)
+
+SOURCES += \
+    $$PWD/main.cpp \
+    $$PWD/testmesh.cpp \
+    $$PWD/subdivisiontests.cpp \
+    $$PWD/decimationtests.cpp \
+    $$PWD/meshbufferbuildertests.cpp \
+    $$PWD/meshclusterstests.cpp
+
+HEADERS += \
+    $$PWD/tests.h \
+    $$PWD/testmesh.h
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
+
+address_sanitizer {
+    message("Enabling Address Sanitizer")
+    QMAKE_CXXFLAGS += -fsanitize=address
+    QMAKE_LFLAGS += -fsanitize=address
+}